@@ -21,6 +21,7 @@ COPYRIGHT (c) 2017 Avraham Bernstein, Jerusalem ISRAEL. All rights reserved.
 LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
 REVISION HISTORY:
 2017-11-26: 1.0.0: AB: original
+2026-10-18: 1.0.1: the trailing self test only with -DCC_BOOST_TEST, so that the header can be included
 ================================================================================
 #endif // end:comment
 
@@ -331,6 +332,10 @@ CC_CAT2(CCB_INDEX_,CCB_INDEX_3 indices)(__VA_ARGS__),CC_CAT2(CCB_INDEX_,CCB_INDE
 
 // #include "cc-boost-vb.h" // 5-64: vband, vbor, vbsum, vbxor
 
+// self test: cpp -P -DCC_BOOST_TEST cc-boost.h | tail -9
+// ==> 0 1 a b c c,b c,b,a a,b,c,a,b,c,a,b,c 3
+
+#ifdef CC_BOOST_TEST
 CCB_NZ(0)
 CCB_NZ(3)
 CCB_INDEX(1)(a,b,c)
@@ -340,3 +345,4 @@ CCB_SELECT(2,(3,2,1),a,b,c)
 CCB_SELECT(3,(3,2,1),a,b,c)
 CCB_REP(3)(a,b,c)
 CCB_VBSUM(3)(1,1,1)
+#endif
@@ -0,0 +1,139 @@
+#pragma once
+/*
+FILE: hist.h
+DESCRIP: banked histogram of 8/16-bit values with 64-bit totals, for the analyses of weyl-prng.c and hwfft.c
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+================================================================================
+USAGE:
+    hist_t h;
+    if (hist_init(&h,256) != 0) ... // out of memory
+    hist_feed8(&h,bytes,n);         // any number of times
+    hist_flush(&h);                 // then h.total[0..nbins-1]
+    or count in the producer's own loop with hist_reserve() and hist_bank()
+    hist_free(&h);
+    The loop ++freq[x] is bound by its store to load forwarding: when x
+    repeats (or collides in the cache) the next increment must wait for the
+    previous one to be written back. So consecutive values go to HIST_BANKS
+    interleaved sub-histograms, whose increments are independent, and the
+    banks are summed at the end. The hot bank counters are 32 bits, so that 4
+    banks of 65536 bins are 1MB and of 256 bins 4KB (L1), and are added into
+    the 64-bit totals before any of them can overflow, i.e. at least every
+    2^32 - 1 values, and by hist_flush().
+    nbins is a power of 2 from 256 to 65536; a value is counted mod nbins.
+================================================================================
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIST_BANKS      4
+#define HIST_MIN_BINS   256
+#define HIST_MAX_BINS   65536
+#define HIST_CHUNK      (1u << 30)  // values per inner pass: any bank counter stays < 2^32
+
+typedef struct {
+    unsigned nbins;
+    uint32_t pending;           // values fed since the last flush: a bound on every bank counter
+    uint32_t * bank;            // HIST_BANKS x nbins
+    uint64_t * total;           // nbins: valid after hist_flush()
+} hist_t;
+
+// returns 0, or -1 if nbins is not supported or out of memory
+
+inline static int hist_init(hist_t * h, unsigned nbins)
+{
+    memset(h,0,sizeof(*h));
+    if (nbins < HIST_MIN_BINS || nbins > HIST_MAX_BINS || (nbins & (nbins - 1)) != 0) {
+        return -1;
+    }
+    h->nbins = nbins;
+    h->bank = (uint32_t *)calloc((size_t)HIST_BANKS*nbins,sizeof(h->bank[0]));
+    h->total = (uint64_t *)calloc(nbins,sizeof(h->total[0]));
+    if (!h->bank || !h->total) {
+        free(h->bank);
+        free(h->total);
+        h->bank = 0;
+        h->total = 0;
+        return -1;
+    }
+    return 0;
+}
+
+inline static void hist_free(hist_t * h)
+{
+    free(h->bank);
+    free(h->total);
+    memset(h,0,sizeof(*h));
+}
+
+// add the banks into the totals, and clear them
+
+inline static void hist_flush(hist_t * h)
+{
+    const unsigned nbins = h->nbins;
+    uint32_t * b = h->bank;
+    unsigned i;
+
+    if (h->pending == 0) {
+        return;
+    }
+    for (i = 0; i < nbins; ++i) {
+        h->total[i] += (uint64_t)b[i] + b[nbins + i] + b[2*nbins + i] + b[3*nbins + i];
+    }
+    memset(b,0,(size_t)HIST_BANKS*nbins*sizeof(b[0]));
+    h->pending = 0;
+}
+
+// For loops that count values as they produce them: after hist_reserve(h,n),
+// n <= HIST_CHUNK, up to n values < nbins may be counted with ++bank[x],
+// spread round robin over the banks from hist_bank(h,0..HIST_BANKS-1).
+
+inline static uint32_t * hist_bank(hist_t * h, unsigned k)
+{
+    return h->bank + (size_t)k*h->nbins;
+}
+
+inline static void hist_reserve(hist_t * h, size_t n)
+{
+    if (n > UINT32_MAX - h->pending) {
+        hist_flush(h);
+    }
+    h->pending += (uint32_t)n;
+}
+
+// one generic inner loop: 4 independent increment streams, one per bank
+
+#define HIST_FEED_(h, p, n) do { \
+    const unsigned mask_ = (h)->nbins - 1; \
+    uint32_t * b0_ = (h)->bank, * b1_ = b0_ + (h)->nbins, * b2_ = b1_ + (h)->nbins, * b3_ = b2_ + (h)->nbins; \
+    size_t m_, i_; \
+    while ((n) > 0) { \
+        m_ = (n) < HIST_CHUNK ? (n) : HIST_CHUNK; \
+        hist_reserve((h),m_); \
+        for (i_ = 0; i_ + 4 <= m_; i_ += 4) { \
+            ++b0_[(p)[i_] & mask_]; \
+            ++b1_[(p)[i_+1] & mask_]; \
+            ++b2_[(p)[i_+2] & mask_]; \
+            ++b3_[(p)[i_+3] & mask_]; \
+        } \
+        for (; i_ < m_; ++i_) { \
+            ++b0_[(p)[i_] & mask_]; \
+        } \
+        (p) += m_; \
+        (n) -= m_; \
+    } \
+} while (0)
+
+inline static void hist_feed8(hist_t * h, const uint8_t * p, size_t n)
+{
+    HIST_FEED_(h,p,n);
+}
+
+inline static void hist_feed16(hist_t * h, const uint16_t * p, size_t n)
+{
+    HIST_FEED_(h,p,n);
+}
@@ -8,6 +8,7 @@ COPYRIGHT (c) 2017 Avraham Bernstein, Jerusalem ISRAEL. All rights reserved.
 LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
 REVISION HISTORY:
 2017-11-26: 1.0.0: AB: original
+2026-10-18: 1.1.0: the 16-bit permutation check counts with hist.h
 ================================================================================
 */
 
@@ -369,6 +370,7 @@ REVISION HISTORY:
 #endif
 
 #include <stdio.h>
+#include "hist.h"
 
 CC_CPP_USE_STD;
 
@@ -657,7 +659,7 @@ static unsigned hwdft_64(uint64_t x)
 
 #define BWIDTH 16
 #define N (1 << BWIDTH)
-uint8_t arr[N];
+uint16_t out[N]; // the image of every input, counted at the end
 uint8_t perm[BWIDTH][BWIDTH];
 
 CC_GCC_ATTRIB(nothrow)
@@ -704,6 +706,7 @@ int main()
     uint16_t hi, lo, x;
     unsigned hi_shift, lo_shift, x_shift, hw;
     uint32_t i;
+    hist_t h;
 
     init(); // init global permutation vectors
 
@@ -731,11 +734,23 @@ int main()
         hw = popcount_32(x) & (BWIDTH-1); // recall that the HW has a binomial distribution
         x = bshuffle_g(x,&perm[hw][0]); // every HW has its own different permutation vector
 
-        if (++arr[x] != 1) {
-            printf("failure:16 = 0x%04x\n",(uint32_t)x);
+        out[i] = x;
+    }
+
+    // a permutation iff every value is hit exactly once
+
+    if (hist_init(&h,N) != 0) {
+        panic("out of memory");
+    }
+    hist_feed16(&h,out,N);
+    hist_flush(&h);
+    for (i = 0; i < N; ++i) {
+        if (h.total[i] != 1) {
+            printf("failure:16 = 0x%04x\n",i);
             break;
         }
     }
+    hist_free(&h);
 
     return 0;
 }
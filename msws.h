@@ -0,0 +1,214 @@
+#pragma once
+/*
+FILE: msws.h
+DESCRIP: the middle square Weyl sequence generators as one family, with compile-time width, S, rotation and finalizer
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+2026-10-18: 1.0.1: MSWS_STEP_(), the step without finalizers, for msws16() of weyl-prng.c
+================================================================================
+USAGE:
+    MSWS_DEFINE(name,W,OUT,S,R,GRAY,CPL)   // at file scope, C or C++
+    ==> uintOUT_t msws_name(msws_t * s)     // one step
+        void msws_name_fill(msws_t * s, void * out, size_t n) // n outputs
+    W       width of x and w: 8, 16, 32 or 64
+    OUT     output: the low 8, 16, 32 or 64 bits of x, OUT <= W
+    S       odd Weyl constant, mod 2^W
+    R       right rotation, 0 .. W-1
+    GRAY    0/1: the finalizer x ^= x >> 1
+    CPL     0/1: the finalizer x = ~x if x has odd parity, after GRAY
+    A step is x = rotr(x*x + (w += S), R), then the finalizers; they feed
+    back, as in weyl-prng.c. The state msws_t is 0 initially. E.g. msws1b()
+    of weyl-prng.c with shift 5 is (16,8,0xabc1,5,0,1), and rnd32() of
+    xxtea.c is (64,32,S,32,0,0).
+    Every parameter is a literal, so each instance is straight-line code with
+    constants only: in C the finalizers are selected by the preprocessor
+    (CCB_IF of cc-boost.h), in C++ MSWS_DEFINE instantiates msws_gen<>, which
+    may also be used directly.
+    MSWS_STEP_(W,S,R) is the step without the finalizers, on W-bit locals x
+    and w, in C and C++; S and R may be run-time values, R < W. msws16() of
+    weyl-prng.c is that step with a run-time S, shift and complement.
+    MSWS_REGISTRY(X) lists the instances of this repo, and msws_registry[]
+    describes them, with their fill function, for drivers that enumerate
+    them; msws_find() looks one up by name. A new instance is one more line.
+================================================================================
+*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "cc-boost.h"
+
+typedef struct { uint64_t x, w; } msws_t; // the low W bits of each
+
+#define MSWS_WORD(W)        CC_CAT3(uint,W,_t)
+#define MSWS_ARITH(W)       CC_CAT2(MSWS_ARITH_,W) // the product without int promotion
+#define MSWS_ARITH_8        uint32_t
+#define MSWS_ARITH_16       uint32_t
+#define MSWS_ARITH_32       uint32_t
+#define MSWS_ARITH_64       uint64_t
+#define MSWS_PARITY(W)      CC_CAT2(MSWS_PARITY_,W) // as wide as x, or gcc tests a setnp instead of a cmovnp
+#define MSWS_PARITY_8       __builtin_parity
+#define MSWS_PARITY_16      __builtin_parity
+#define MSWS_PARITY_32      __builtin_parity
+#define MSWS_PARITY_64      __builtin_parityll
+
+// x = rotr(x*x + (w += S), R) on the W-bit locals x and w, W a literal
+
+#define MSWS_STEP_(W,S,R) \
+    w = (MSWS_WORD(W))(w + (S)); \
+    x = (MSWS_WORD(W))((MSWS_ARITH(W))x * x + w); \
+    x = (MSWS_WORD(W))((MSWS_ARITH(W))x >> (R) | (MSWS_ARITH(W))x << ((W - (R)) % W));
+
+#ifdef __cplusplus
+
+template <unsigned W> struct msws_word;
+template <> struct msws_word<8> { typedef uint8_t type; typedef uint32_t arith; };
+template <> struct msws_word<16> { typedef uint16_t type; typedef uint32_t arith; };
+template <> struct msws_word<32> { typedef uint32_t type; typedef uint32_t arith; };
+template <> struct msws_word<64> { typedef uint64_t type; typedef uint64_t arith; };
+
+template <unsigned W, unsigned OUT, uint64_t S, unsigned R, bool GRAY, bool CPL>
+struct msws_gen {
+    typedef typename msws_word<W>::type word_t;
+    typedef typename msws_word<W>::arith arith_t;
+    typedef typename msws_word<OUT>::type out_t;
+
+    static_assert(OUT <= W, "the output is the low OUT bits of x");
+    static_assert((S & 1) == 1, "S must be odd");
+    static_assert(R < W, "rotation 0 .. W-1");
+
+    // on W-bit locals: a wider state would cost a zero extension per step,
+    // and turn the cmov of the complement into a branch
+
+    __attribute__((always_inline))
+    static inline void core(word_t & x, word_t & w)
+    {
+        w = (word_t)(w + S);
+        x = (word_t)((arith_t)x * x + w);
+        x = (word_t)((arith_t)x >> R | (arith_t)x << ((W - R) % W));
+        if (GRAY) x ^= x >> 1;
+        if (CPL) x = (W == 64 ? __builtin_parityll(x) : __builtin_parity(x)) ? (word_t)~x : x; // a cmov: the parity is random
+    }
+
+    __attribute__((always_inline))
+    static inline out_t step(msws_t * s)
+    {
+        word_t x = (word_t)s->x, w = (word_t)s->w;
+
+        core(x,w);
+        s->x = x;
+        s->w = w;
+        return (out_t)x;
+    }
+
+    static void fill(msws_t * s, void * out, size_t n)
+    {
+        out_t * p = (out_t *)out;
+        word_t x = (word_t)s->x, w = (word_t)s->w;
+
+        for (size_t i = 0; i < n; ++i) {
+            core(x,w);
+            p[i] = (out_t)x;
+        }
+        s->x = x;
+        s->w = w;
+    }
+};
+
+#define MSWS_DEFINE(name,W,OUT,S,R,GRAY,CPL) \
+__attribute__((always_inline,unused)) \
+inline static MSWS_WORD(OUT) CC_CAT2(msws_,name)(msws_t * s) \
+{ \
+    return msws_gen<W,OUT,(uint64_t)(S),R,GRAY,CPL>::step(s); \
+} \
+ \
+__attribute__((nonnull,unused)) \
+static void CC_CAT3(msws_,name,_fill)(msws_t * s, void * out, size_t n) \
+{ \
+    msws_gen<W,OUT,(uint64_t)(S),R,GRAY,CPL>::fill(s,out,n); \
+}
+
+#else
+
+// one step on the W-bit locals x and w, see msws_gen<>::core()
+
+#define MSWS_CORE_(W,S,R,GRAY,CPL) \
+    MSWS_STEP_(W,S,R) \
+    CCB_IF(GRAY)(x ^= x >> 1;,) \
+    CCB_IF(CPL)(x = MSWS_PARITY(W)(x) ? (MSWS_WORD(W))~x : x;,)
+
+#define MSWS_DEFINE(name,W,OUT,S,R,GRAY,CPL) \
+__attribute__((always_inline,unused)) \
+inline static MSWS_WORD(OUT) CC_CAT2(msws_,name)(msws_t * s) \
+{ \
+    MSWS_WORD(W) x = (MSWS_WORD(W))s->x, w = (MSWS_WORD(W))s->w; \
+ \
+    MSWS_CORE_(W,S,R,GRAY,CPL) \
+    s->x = x; \
+    s->w = w; \
+    return (MSWS_WORD(OUT))x; \
+} \
+ \
+__attribute__((nonnull,unused)) \
+static void CC_CAT3(msws_,name,_fill)(msws_t * s, void * out, size_t n) \
+{ \
+    MSWS_WORD(OUT) * p = (MSWS_WORD(OUT) *)out; \
+    MSWS_WORD(W) x = (MSWS_WORD(W))s->x, w = (MSWS_WORD(W))s->w; \
+    size_t i; \
+ \
+    for (i = 0; i < n; ++i) { \
+        MSWS_CORE_(W,S,R,GRAY,CPL) \
+        p[i] = (MSWS_WORD(OUT))x; \
+    } \
+    s->x = x; \
+    s->w = w; \
+}
+
+#endif // __cplusplus
+
+// the registry: the 4 variants of weyl-prng.c at their default shift 5, and
+// rnd32(); and one of 8 and of 32 bits
+
+#define MSWS_REGISTRY(X) \
+    X(1a,       16, 8,  0xabc1,                 5,  0, 0) \
+    X(1b,       16, 8,  0xabc1,                 5,  0, 1) \
+    X(2a,       16, 8,  0x0ff7,                 5,  0, 0) \
+    X(2b,       16, 8,  0x0ff7,                 5,  0, 1) \
+    X(rnd32,    64, 32, 0xb5ad4eceda1ce2a9ULL,  32, 0, 0) \
+    X(w8gb,     8,  8,  0x9b,                   3,  1, 1) \
+    X(w32,      32, 16, 0xb5ad4ecfUL,           16, 0, 0)
+
+MSWS_REGISTRY(MSWS_DEFINE)
+
+typedef struct {
+    const char * name;
+    unsigned width, out_bits;
+    uint64_t S;
+    unsigned shift, gray, complement;
+    void (*fill)(msws_t * s, void * out, size_t n); // n outputs of out_bits/8 bytes
+} msws_info_t;
+
+#define MSWS_INFO_(name,W,OUT,S,R,GRAY,CPL) \
+    { CC_STR(name), W, OUT, S, R, GRAY, CPL, CC_CAT3(msws_,name,_fill) },
+
+__attribute__((unused))
+static const msws_info_t msws_registry[] = { MSWS_REGISTRY(MSWS_INFO_) };
+
+#define MSWS_NREGISTRY (sizeof(msws_registry)/sizeof(msws_registry[0]))
+
+// returns 0 if there is no such instance
+
+__attribute__((unused))
+static const msws_info_t * msws_find(const char * name)
+{
+    size_t i;
+
+    for (i = 0; i < MSWS_NREGISTRY; ++i) {
+        if (strcmp(msws_registry[i].name,name) == 0) {
+            return &msws_registry[i];
+        }
+    }
+    return 0;
+}
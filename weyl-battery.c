@@ -0,0 +1,651 @@
+/*
+FILE: weyl-battery.c
+DESCRIP: single-pass streaming statistical test battery for rnd32() and the msws variants of weyl-prng.c
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+2026-10-18: 1.1.0: battery_eval(), WEYL_BATTERY_NO_MAIN for weyl-sweep.c
+2026-10-18: 1.1.1: rnd32 is msws_rnd32_fill() of msws.h, no copy of rnd32(): no -s
+================================================================================
+USAGE: weyl-battery [-n log2_bytes] [-r shift] [generator ...]
+    generator   rnd32, 1a, 1b, 2a, 2b; default all, each on its own thread
+    -n log2     bytes per generator = 2^log2, default 28
+    -r shift    msws rotation, default 5
+    rnd32 is the instance of MSWS_REGISTRY in msws.h, i.e. rnd32() of xxtea.c
+    with S = 0xb5ad4eceda1ce2a9: another S is another line in the registry.
+BUILD: cc -O3 -march=native -pthread -o weyl-battery weyl-battery.c -lm
+    The generator output is fed to battery_feed() in batches of 64KB as a
+    stream of 32-bit words (rnd32) or of bytes packed 4 per word (msws). The
+    state of every test lives in battery_t: no allocation, and every batch is
+    consumed in one pass. The tests (Knuth TAOCP vol 2, 3.3.2):
+      - frequency: chi-square of the 256 byte values; 4 banks of 32-bit
+        counters, flushed to 64 bits at the end of each batch
+      - serial correlation: of successive bytes, from 3 sums that vectorize;
+        normal approximation
+      - gap: gaps between bytes < 64, lengths 0..31 and >= 32; the hits of 8
+        bytes at a time are found with SWAR, then walked with ctz
+      - runs up: of words, the element after each run is discarded so that
+        the run lengths are independent: Pr[r] = r/(r+1)!; branch-free
+      - birthday spacings: 4096 word birthdays in a year of 2^32 days; the
+        number of repeated spacings is Poisson(4); O(m) per sample with a
+        bucket sort and a hash table
+      - poker: each word is a hand of 8 nibbles; the number of distinct
+        nibbles vs. the Stirling numbers S(8,r)
+    Each test reports a p-value; FAIL if p < 1e-6 or p > 1 - 1e-6.
+================================================================================
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WEYL_PRNG_NO_MAIN
+#include "weyl-prng.c"
+#include "msws.h"
+
+#define BAT_BATCH       16384           // words per batch: 64KB
+#define BAT_FREQ_MAX    (1u << 30)      // bytes per flush of the 32-bit frequency banks
+#define BAT_SER_BLOCK   65536           // bytes per flush of the 32-bit serial sums: 65536*255*255 < 2^32
+#define BAT_GAP_T       32
+#define BAT_GAP_LO      64              // a hit is a byte < 64: p = 1/4
+#define BAT_RUN_T       8
+#define BAT_BDAY_LOG2   12
+#define BAT_BDAY_M      (1 << BAT_BDAY_LOG2) // birthdays per sample: lambda = m^3/(4*2^32) = 4
+#define BAT_BDAY_T      16
+#define BAT_POKER_K     8               // nibbles per hand
+
+typedef struct {
+    uint64_t nbytes;
+
+    uint32_t bank[4][256];              // frequency
+    uint64_t freq[256];
+
+    uint64_t s1, s2, s11;               // serial: sum u, sum u^2, sum u[i]*u[i+1]
+    uint8_t first, last;
+
+    int64_t gap_last;                   // gap: byte index of the last hit
+    uint64_t gap[BAT_GAP_T + 1];
+
+    uint32_t run_prev, run_len, run_skip; // runs up
+    uint64_t run[BAT_RUN_T + 1];
+
+    uint32_t bday[BAT_BDAY_M], bday_tmp[BAT_BDAY_M], bday_cnt[BAT_BDAY_M]; // birthday spacings
+    uint32_t bday_tab[4*BAT_BDAY_M];   // hash table of the spacings, load <= 1/4
+    uint32_t bday_n;
+    uint64_t bday_r[BAT_BDAY_T + 1];
+
+    uint16_t poker_mask[256];           // poker: the nibbles of a byte, as a set
+    uint64_t poker[BAT_POKER_K + 1];
+} battery_t;
+
+static void battery_init(battery_t * b)
+{
+    unsigned k;
+
+    memset(b,0,sizeof(*b));
+    b->gap_last = -1;
+    b->run_skip = 1; // the first word starts a run
+    for (k = 0; k < 256; ++k) {
+        b->poker_mask[k] = (uint16_t)((1u << (k & 15)) | (1u << (k >> 4)));
+    }
+}
+
+static void bat_freq(battery_t * b, const uint8_t * p, size_t len)
+{
+    size_t i;
+    unsigned k;
+
+    for (i = 0; i + 4 <= len; i += 4) {
+        ++b->bank[0][p[i]];
+        ++b->bank[1][p[i+1]];
+        ++b->bank[2][p[i+2]];
+        ++b->bank[3][p[i+3]];
+    }
+    for (; i < len; ++i) {
+        ++b->bank[0][p[i]];
+    }
+    for (k = 0; k < 256; ++k) {
+        b->freq[k] += (uint64_t)b->bank[0][k] + b->bank[1][k] + b->bank[2][k] + b->bank[3][k];
+    }
+    memset(b->bank,0,sizeof(b->bank));
+}
+
+static void bat_serial(battery_t * b, const uint8_t * p, size_t len)
+{
+    size_t i, j, m;
+
+    if (b->nbytes == 0) {
+        b->first = p[0];
+    } else {
+        b->s11 += (uint32_t)b->last * p[0];
+    }
+    for (i = 0; i < len; i += m) {
+        uint32_t s1 = 0, s2 = 0, s11 = 0;
+        m = len - i < BAT_SER_BLOCK ? len - i : BAT_SER_BLOCK;
+        for (j = i; j < i + m; ++j) {
+            s1 += p[j];
+            s2 += (uint32_t)p[j] * p[j];
+        }
+        for (j = i; j + 1 < i + m; ++j) {
+            s11 += (uint32_t)p[j] * p[j+1];
+        }
+        if (i + m < len) {
+            s11 += (uint32_t)p[i+m-1] * p[i+m];
+        }
+        b->s1 += s1;
+        b->s2 += s2;
+        b->s11 += s11;
+    }
+    b->last = p[len-1];
+}
+
+// the hits of 64 bytes as a 64-bit mask: per 8 bytes, bit 7 of a byte is set
+// iff its top 2 bits are 0, and the multiply gathers those 8 bits into 1 byte
+
+static void bat_gap(battery_t * b, const uint8_t * p, size_t len)
+{
+    const uint64_t hi = 0x8080808080808080ULL, hi2 = 0xc0c0c0c0c0c0c0c0ULL;
+    int64_t last = b->gap_last;
+    size_t i, k;
+
+    for (i = 0; i < len; i += 64) {
+        uint64_t mask = 0;
+        for (k = 0; k < 64; k += 8) {
+            uint64_t x = ~(uint64_t)0, h;
+            if (i + k + 8 <= len) {
+                memcpy(&x,p + i + k,8);
+            } else if (i + k < len) {
+                memcpy(&x,p + i + k,len - i - k); // missing bytes are 0xff: no hit
+            }
+            x &= hi2;
+            h = ~(x | (x << 1)) & hi;
+            mask |= ((h >> 7) * 0x0102040810204080ULL) >> 56 << k;
+        }
+        while (mask) {
+            int64_t at = (int64_t)(b->nbytes + i) + __builtin_ctzll(mask);
+            uint64_t g = at - last - 1;
+            ++b->gap[g < BAT_GAP_T ? g : BAT_GAP_T];
+            last = at;
+            mask &= mask - 1;
+        }
+    }
+    b->gap_last = last;
+}
+
+static void bat_runs(battery_t * b, const uint32_t * w, size_t n)
+{
+    uint32_t prev = b->run_prev, len = b->run_len, skip = b->run_skip;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        uint32_t up = w[i] > prev;
+        uint32_t end = !skip & !up;
+        b->run[len < BAT_RUN_T ? len : BAT_RUN_T] += end;
+        len = skip ? 1 : len + 1; // after an end len is garbage, reset by the skip
+        skip = end;
+        prev = w[i];
+    }
+    b->run_prev = prev;
+    b->run_len = len;
+    b->run_skip = skip;
+}
+
+// the number of repeated spacings of the sorted birthdays: a counting sort
+// on the top 12 bits (~1 birthday per bucket) finished by insertion sort, then
+// the spacings go into an open addressing hash table; O(m) per sample
+
+static void bat_bday_sample(battery_t * b)
+{
+    uint32_t * y = b->bday, * s = b->bday_tmp, * cnt = b->bday_cnt, * tab = b->bday_tab;
+    uint32_t r = 0, zeros = 0, y0, v, h;
+    unsigned j, i, sum;
+
+    memset(cnt,0,sizeof(b->bday_cnt));
+    for (j = 0; j < BAT_BDAY_M; ++j) {
+        ++cnt[y[j] >> (32 - BAT_BDAY_LOG2)];
+    }
+    for (j = 0, sum = 0; j < BAT_BDAY_M; ++j) {
+        uint32_t c = cnt[j];
+        cnt[j] = sum;
+        sum += c;
+    }
+    for (j = 0; j < BAT_BDAY_M; ++j) {
+        s[cnt[y[j] >> (32 - BAT_BDAY_LOG2)]++] = y[j];
+    }
+    for (j = 1; j < BAT_BDAY_M; ++j) {
+        v = s[j];
+        for (i = j; i > 0 && s[i-1] > v; --i) {
+            s[i] = s[i-1];
+        }
+        s[i] = v;
+    }
+
+    y0 = s[0];
+    for (j = 0; j + 1 < BAT_BDAY_M; ++j) {
+        s[j] = s[j+1] - s[j];
+    }
+    s[BAT_BDAY_M-1] = y0 - s[BAT_BDAY_M-1]; // mod 2^32: around the year
+
+    // 0 marks a free slot, so the 0 spacings (repeated birthdays) are counted
+    // apart; the used slots are kept in y, to clear the table afterwards
+    for (j = 0; j < BAT_BDAY_M; ++j) {
+        v = s[j];
+        zeros += v == 0;
+        h = (v * 0x9e3779b1u) >> (32 - BAT_BDAY_LOG2 - 2);
+        while (tab[h] != 0 && tab[h] != v) {
+            h = (h + 1) & (4*BAT_BDAY_M - 1);
+        }
+        r += v != 0 && tab[h] == v;
+        tab[h] = v;
+        y[j] = h;
+    }
+    for (j = 0; j < BAT_BDAY_M; ++j) {
+        tab[y[j]] = 0;
+    }
+    r += zeros ? zeros - 1 : 0;
+
+    ++b->bday_r[r < BAT_BDAY_T ? r : BAT_BDAY_T];
+    b->bday_n = 0;
+}
+
+static void bat_bday(battery_t * b, const uint32_t * w, size_t n)
+{
+    size_t i = 0, m;
+
+    while (i < n) {
+        m = BAT_BDAY_M - b->bday_n;
+        m = n - i < m ? n - i : m;
+        memcpy(b->bday + b->bday_n,w + i,m*sizeof(w[0]));
+        b->bday_n += m;
+        i += m;
+        if (b->bday_n == BAT_BDAY_M) {
+            bat_bday_sample(b);
+        }
+    }
+}
+
+static void bat_poker(battery_t * b, const uint32_t * w, size_t n)
+{
+    uint64_t cnt[2][BAT_POKER_K + 1] = { { 0 } };
+    size_t i;
+    unsigned k;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        uint32_t x = w[i], y = w[i+1];
+        ++cnt[0][__builtin_popcount(b->poker_mask[x & 0xff] | b->poker_mask[(x >> 8) & 0xff]
+            | b->poker_mask[(x >> 16) & 0xff] | b->poker_mask[x >> 24])];
+        ++cnt[1][__builtin_popcount(b->poker_mask[y & 0xff] | b->poker_mask[(y >> 8) & 0xff]
+            | b->poker_mask[(y >> 16) & 0xff] | b->poker_mask[y >> 24])];
+    }
+    for (; i < n; ++i) {
+        uint32_t x = w[i];
+        ++cnt[0][__builtin_popcount(b->poker_mask[x & 0xff] | b->poker_mask[(x >> 8) & 0xff]
+            | b->poker_mask[(x >> 16) & 0xff] | b->poker_mask[x >> 24])];
+    }
+    for (k = 0; k <= BAT_POKER_K; ++k) {
+        b->poker[k] += cnt[0][k] + cnt[1][k];
+    }
+}
+
+// n words, as 4n bytes in memory order
+
+__attribute__((nonnull))
+static void battery_feed(battery_t * b, const uint32_t * w, size_t n)
+{
+    const uint8_t * p = (const uint8_t *)w;
+    size_t i, m;
+
+    for (i = 0; i < n; i += m) {
+        m = n - i < BAT_FREQ_MAX/4 ? n - i : BAT_FREQ_MAX/4;
+
+        bat_freq(b,p + 4*i,4*m);
+        bat_serial(b,p + 4*i,4*m);
+        bat_gap(b,p + 4*i,4*m);
+        bat_runs(b,w + i,m);
+        bat_bday(b,w + i,m);
+        bat_poker(b,w + i,m);
+
+        b->nbytes += 4*m;
+    }
+}
+
+// regularized upper incomplete gamma Q(a,x): series for x < a+1, else
+// continued fraction (modified Lentz)
+
+static double gamma_q(double a, double x)
+{
+    const double tiny = 1e-300;
+    double sum, term, an, bn, c, d, h;
+    int i;
+
+    if (x <= 0) {
+        return 1;
+    }
+    if (x < a + 1) {
+        sum = term = 1/a;
+        for (i = 1; i < 10000 && fabs(term) > fabs(sum)*1e-16; ++i) {
+            term *= x/(a + i);
+            sum += term;
+        }
+        return 1 - sum*exp(-x + a*log(x) - lgamma(a));
+    }
+    bn = x + 1 - a;
+    c = 1/tiny;
+    d = 1/bn;
+    h = d;
+    for (i = 1; i < 10000; ++i) {
+        an = -i*(i - a);
+        bn += 2;
+        d = an*d + bn; if (fabs(d) < tiny) d = tiny;
+        c = bn + an/c; if (fabs(c) < tiny) c = tiny;
+        d = 1/d;
+        h *= d*c;
+        if (fabs(d*c - 1) < 1e-16) {
+            break;
+        }
+    }
+    return exp(-x + a*log(x) - lgamma(a)) * h;
+}
+
+// chi-square of obs[] vs. prob[], pooling adjacent bins with expected < 5;
+// returns the p-value, or -1 if there are too few samples
+
+static double chi2_test(const uint64_t * obs, const double * prob, unsigned nbins, double * chi2, int * dof)
+{
+    double total = 0, expected = 0, observed = 0;
+    unsigned k;
+
+    for (k = 0; k < nbins; ++k) {
+        total += obs[k];
+    }
+    *chi2 = 0;
+    *dof = -1;
+    for (k = 0; k < nbins; ++k) {
+        expected += prob[k] * total;
+        observed += obs[k];
+        if (expected >= 5 || k == nbins - 1) {
+            if (expected > 0) {
+                *chi2 += (observed - expected) * (observed - expected) / expected;
+                ++*dof;
+            }
+            expected = observed = 0;
+        }
+    }
+    return *dof > 0 ? gamma_q(*dof/2.0,*chi2/2) : -1;
+}
+
+#define BAT_NTESTS  6
+
+typedef struct {
+    const char * name;
+    double stat, p;                     // p = -1: too few samples
+    int dof;                            // 0: not a chi-square
+} bat_result_t;
+
+static void bat_set(bat_result_t * r, const char * name, double stat, int dof, double p)
+{
+    r->name = name;
+    r->stat = stat;
+    r->dof = dof;
+    r->p = p;
+}
+
+// the statistic, dof and p-value of every test
+
+static void battery_eval(const battery_t * b, bat_result_t res[BAT_NTESTS])
+{
+    double prob[256], chi2, p, n, C, mu, sigma;
+    int dof;
+    unsigned k, r;
+
+    // frequency
+    for (k = 0; k < 256; ++k) {
+        prob[k] = 1/256.0;
+    }
+    p = chi2_test(b->freq,prob,256,&chi2,&dof);
+    bat_set(&res[0],"frequency",chi2,dof,p);
+
+    // serial correlation, cyclic: C ~ N(mu, sigma^2)
+    n = b->nbytes;
+    if (n > 3) {
+        double s1 = b->s1, s2 = b->s2, s11 = b->s11 + (double)b->last * b->first;
+        C = (n*s11 - s1*s1) / (n*s2 - s1*s1);
+        mu = -1/(n - 1);
+        sigma = sqrt(n*(n - 3)/(n + 1)) / (n - 1);
+        p = erfc(fabs(C - mu)/sigma/sqrt(2.0));
+    } else {
+        C = 0;
+        p = -1;
+    }
+    bat_set(&res[1],"serial corr",C,0,p);
+
+    // gap: Pr[r] = q^r p, Pr[>= T] = q^T
+    for (k = 0; k <= BAT_GAP_T; ++k) {
+        prob[k] = pow(1 - BAT_GAP_LO/256.0,k) * (k < BAT_GAP_T ? BAT_GAP_LO/256.0 : 1);
+    }
+    p = chi2_test(b->gap,prob,BAT_GAP_T + 1,&chi2,&dof);
+    bat_set(&res[2],"gap",chi2,dof,p);
+
+    // runs up: Pr[r] = r/(r+1)!, Pr[>= T] = 1/T!
+    prob[0] = 0;
+    for (k = 1; k <= BAT_RUN_T; ++k) {
+        prob[k] = exp((k < BAT_RUN_T ? log((double)k) - lgamma(k + 2.0) : -lgamma(k + 1.0)));
+    }
+    p = chi2_test(b->run + 1,prob + 1,BAT_RUN_T,&chi2,&dof);
+    bat_set(&res[3],"runs up",chi2,dof,p);
+
+    // birthday spacings: Poisson(4)
+    {
+        const double lambda = (double)BAT_BDAY_M*BAT_BDAY_M*BAT_BDAY_M / 4 / 4294967296.0;
+        double tail = 1;
+        for (k = 0; k < BAT_BDAY_T; ++k) {
+            prob[k] = exp(-lambda + k*log(lambda) - lgamma(k + 1.0));
+            tail -= prob[k];
+        }
+        prob[BAT_BDAY_T] = tail;
+    }
+    p = chi2_test(b->bday_r,prob,BAT_BDAY_T + 1,&chi2,&dof);
+    bat_set(&res[4],"birthday spacing",chi2,dof,p);
+
+    // poker: Pr[r distinct] = 16!/(16-r)! * S(K,r) / 16^K
+    {
+        double S[BAT_POKER_K + 1][BAT_POKER_K + 1];
+        memset(S,0,sizeof(S));
+        S[0][0] = 1;
+        for (k = 1; k <= BAT_POKER_K; ++k) {
+            for (r = 1; r <= k; ++r) {
+                S[k][r] = r*S[k-1][r] + S[k-1][r-1];
+            }
+        }
+        prob[0] = 0;
+        for (r = 1; r <= BAT_POKER_K; ++r) {
+            prob[r] = exp(lgamma(17.0) - lgamma(17.0 - r) - BAT_POKER_K*log(16.0)) * S[BAT_POKER_K][r];
+        }
+    }
+    p = chi2_test(b->poker + 1,prob + 1,BAT_POKER_K,&chi2,&dof);
+    bat_set(&res[5],"poker",chi2,dof,p);
+}
+
+// FAIL if p < 1e-6 or p > 1 - 1e-6, weak if p < 1e-3 or p > 1 - 1e-3
+
+static int bat_fail(double p)
+{
+    return p >= 0 && (p < 1e-6 || p > 1 - 1e-6);
+}
+
+// print every test; returns the number of failed tests
+
+__attribute__((unused))
+static int battery_report(const battery_t * b)
+{
+    bat_result_t res[BAT_NTESTS];
+    int fails = 0, j;
+
+    battery_eval(b,res);
+    printf("  %-16s %14s %6s\n", "test", "statistic", "dof");
+    for (j = 0; j < BAT_NTESTS; ++j) {
+        const bat_result_t * r = &res[j];
+        char d[16] = "";
+
+        if (r->p < 0) {
+            printf("  %-16s %14s\n", r->name, "too few samples");
+            continue;
+        }
+        if (r->dof > 0) {
+            snprintf(d,sizeof(d),"%d",r->dof);
+        }
+        printf("  %-16s %14.4f %6s  p = %-10.4g %s\n", r->name, r->stat, d, r->p,
+            bat_fail(r->p) ? "FAIL" : r->p < 1e-3 || r->p > 1 - 1e-3 ? "weak" : "ok");
+        fails += bat_fail(r->p);
+    }
+    return fails;
+}
+
+#ifndef WEYL_BATTERY_NO_MAIN // i.e. when included by a tool
+
+#define BAT_RND32   4 // generator index after the 4 msws variants
+
+typedef struct {
+    const char * name;
+    unsigned gen;
+    uint16_t shift;
+    uint64_t S, nwords;
+    double t_gen, t_test;
+    battery_t b;
+} bat_job_t;
+
+// per thread: the generators share the cpus
+
+static double thread_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// always inlined with a constant fn, so that the state stays in registers
+
+__attribute__((always_inline))
+inline static void msws_fill(uint8_t (*fn)(msws16_t *, uint16_t), msws16_t * st, uint16_t shift, uint8_t * p, size_t n)
+{
+    msws16_t s = *st;
+    size_t i;
+
+    for (i = 0; i < n; ++i) {
+        p[i] = fn(&s,shift);
+    }
+    *st = s;
+}
+
+static void * bat_worker(void * arg)
+{
+    bat_job_t * job = (bat_job_t *)arg;
+    uint32_t buf[BAT_BATCH];
+    uint8_t * p = (uint8_t *)buf;
+    msws_t r = { 0, 0 };
+    msws16_t s = { 0, 0 };
+    uint64_t i;
+    size_t n;
+    double t0, t1, t2;
+
+    battery_init(&job->b);
+
+    for (i = 0; i < job->nwords; i += n) {
+        n = job->nwords - i < BAT_BATCH ? job->nwords - i : BAT_BATCH;
+        t0 = thread_sec();
+        switch (job->gen) {
+        case 0: msws_fill(msws1a,&s,job->shift,p,4*n); break;
+        case 1: msws_fill(msws1b,&s,job->shift,p,4*n); break;
+        case 2: msws_fill(msws2a,&s,job->shift,p,4*n); break;
+        case 3: msws_fill(msws2b,&s,job->shift,p,4*n); break;
+        default: msws_rnd32_fill(&r,buf,n); break;
+        }
+        t1 = thread_sec();
+        battery_feed(&job->b,buf,n);
+        t2 = thread_sec();
+        job->t_gen += t1 - t0;
+        job->t_test += t2 - t1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char * argv[])
+{
+    static const char * names[] = { "1a", "1b", "2a", "2b", "rnd32" };
+    static bat_job_t jobs[5];
+    const unsigned ngens = sizeof(names)/sizeof(names[0]);
+    pthread_t tid[5];
+    unsigned log2_bytes = 28, shift = 5, njobs = 0, j, g;
+    int opt, fails = 0;
+
+    while ((opt = getopt(argc,argv,"n:r:")) != -1) {
+        switch (opt) {
+        case 'n': log2_bytes = atoi(optarg); break;
+        case 'r': shift = atoi(optarg); break;
+        default:
+            fprintf(stderr,"usage: see header of weyl-battery.c\n");
+            return 1;
+        }
+    }
+    if (log2_bytes < 2 || log2_bytes > 48) {
+        fprintf(stderr,"E: need 2 <= log2_bytes <= 48\n");
+        return 1;
+    }
+
+    for (g = 0; g < ngens; ++g) {
+        int want = optind == argc; // default: all
+        for (j = optind; j < (unsigned)argc; ++j) {
+            want |= strcmp(argv[j],names[g]) == 0;
+        }
+        if (want) {
+            jobs[njobs].name = names[g];
+            jobs[njobs].gen = g;
+            jobs[njobs].shift = (uint16_t)shift;
+            jobs[njobs].S = g == BAT_RND32 ? msws_find("rnd32")->S : g < 2 ? S1 : S2;
+            jobs[njobs].nwords = ((uint64_t)1 << log2_bytes) / 4;
+            ++njobs;
+        }
+    }
+    for (j = optind; j < (unsigned)argc; ++j) {
+        for (g = 0; g < ngens && strcmp(argv[j],names[g]) != 0; ++g) {
+        }
+        if (g == ngens) {
+            fprintf(stderr,"E: unknown generator %s\n", argv[j]);
+            return 1;
+        }
+    }
+
+    for (j = 0; j < njobs; ++j) {
+        if (pthread_create(&tid[j],0,bat_worker,&jobs[j]) != 0) {
+            fprintf(stderr,"E: pthread_create() failed\n");
+            return 1;
+        }
+    }
+    for (j = 0; j < njobs; ++j) {
+        pthread_join(tid[j],0);
+    }
+
+    for (j = 0; j < njobs; ++j) {
+        const bat_job_t * job = &jobs[j];
+        double mb = job->nwords * 4 / 1e6;
+
+        if (job->gen == BAT_RND32) {
+            printf("\n**** rnd32: S=0x%016llx, 2^%u bytes\n", (unsigned long long)job->S, log2_bytes);
+        } else {
+            printf("\n**** %s: SHIFT=%2d, S=0x%04x, 2^%u bytes\n", job->name, (int)job->shift, (int)job->S, log2_bytes);
+        }
+        printf("  generator %.0f MB/s, battery %.0f MB/s\n", mb/job->t_gen, mb/job->t_test);
+        fails += battery_report(&job->b);
+    }
+
+    return fails != 0;
+}
+
+#endif // WEYL_BATTERY_NO_MAIN
@@ -0,0 +1,314 @@
+/*
+FILE: weyl-cycles.c
+DESCRIP: exact cycle structure and period of the 16-bit msws generators of weyl-prng.c
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+2026-10-18: 1.1.0: the return map with msws16v(): 16 or 32 start values per vector
+2026-10-18: 1.1.1: run_jobs() asserts njobs <= MAX_THREADS, as xxtea_run_jobs() does
+2026-10-18: 1.1.2: S^-1 and k0 in uint32_t: S*inv overflowed int for S near 0xffff
+================================================================================
+USAGE: weyl-cycles [-S S [-c]] [-r shift] [-x x0] [-w w0] [-t threads]
+    -S S        odd Weyl constant; default: the 4 variants of weyl-prng.c
+    -c          with the popcount parity complement (i.e. the "b" variants)
+    -r shift    rotation, default 5
+    -x x0 -w w0 start state, default 0 0 (as in weyl-prng.c)
+    -t threads  default: one per online cpu
+BUILD: cc -O2 -march=native -pthread -o weyl-cycles weyl-cycles.c
+    The state (x, w) has 32 bits, but w = w0 + t*S has period exactly 2^16
+    (S odd), independent of x. So instead of walking the 2^32 state graph
+    with a 512MB visited bitmap, tabulate the return map g(x) = the x after
+    2^16 steps from (x, w=0): 2^16 independent runs of 2^16 steps, in
+    parallel, and in the vector lanes of msws16v(). Every orbit passes through w = 0 periodically, so:
+      - the cycles of the generator are the cycles of g; a cycle of g of
+        length L is a cycle of 2^16*L steps
+      - the period from a start state is 2^16 * (the period of g from the
+        first x at w = 0), found with Brent's algorithm on the table
+      - the exact tail (in steps) is found by stepping the state and the
+        state one period ahead in lockstep, for at most 2^16 steps
+    i.e. 2^32 generator steps plus O(2^16) table work per (S, shift).
+================================================================================
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WEYL_PRNG_NO_MAIN
+#include "weyl-prng.c"
+
+#define CYC_N       65536 // = 2^16: the period of w, and the number of x values
+#define MAX_THREADS 64
+
+typedef struct {
+    uint16_t S, shift;
+    int complement;
+} cyc_param_t;
+
+typedef struct {
+    const cyc_param_t * param;
+    uint16_t * g;
+    unsigned begin, end;
+} cyc_job_t;
+
+// g(x) for x in [begin, end), MSWS16_W start values at a time in the lanes
+// of msws16v()
+
+static void * cyc_worker(void * arg)
+{
+    const cyc_job_t * job = (const cyc_job_t *)arg;
+    const cyc_param_t * param = job->param;
+    msws16v_t s;
+    unsigned x, k, l;
+
+    for (x = job->begin; x < job->end; x += MSWS16_W) {
+        for (l = 0; l < MSWS16_W; ++l) {
+            msws16v_set(&s,l,(uint16_t)(x + l),0,param->S,param->shift,param->complement);
+        }
+        for (k = 0; k < CYC_N; ++k) {
+            msws16v(&s,0);
+        }
+        for (l = 0; l < MSWS16_W && x + l < job->end; ++l) {
+            job->g[x + l] = s.x[l]; // and s.w == 0 again
+        }
+    }
+    return 0;
+}
+
+// Run fn(jobs[0..njobs-1]): the last job runs on the calling thread. If a
+// thread cannot be created then its job also runs on the calling thread.
+// A copy of xxtea_run_jobs() of xxtea.c: the weyl-* tools do not include the
+// cipher; a fix to either belongs in both.
+
+static void run_jobs(void * (*fn)(void *), void * jobs, size_t job_size, unsigned njobs)
+{
+    pthread_t tid[MAX_THREADS];
+    int started[MAX_THREADS];
+    unsigned t;
+
+    assert(njobs <= MAX_THREADS);
+
+    for (t = 0; t + 1 < njobs; ++t) {
+        started[t] = pthread_create(&tid[t], 0, fn, (char *)jobs + t*job_size) == 0;
+    }
+    if (njobs > 0) {
+        fn((char *)jobs + (njobs-1)*job_size);
+    }
+    for (t = 0; t + 1 < njobs; ++t) {
+        if (started[t]) {
+            pthread_join(tid[t], 0);
+        } else {
+            fn((char *)jobs + t*job_size);
+        }
+    }
+}
+
+// Brent's algorithm on the table: lambda = period, mu = tail, in g steps
+
+static void brent(const uint16_t * g, uint16_t x0, uint32_t * lambda, uint32_t * mu)
+{
+    uint32_t power = 1, lam = 1, m = 0, i;
+    uint16_t tortoise = x0, hare = g[x0];
+
+    while (tortoise != hare) {
+        if (power == lam) {
+            tortoise = hare;
+            power *= 2;
+            lam = 0;
+        }
+        hare = g[hare];
+        lam += 1;
+    }
+
+    tortoise = hare = x0;
+    for (i = 0; i < lam; ++i) {
+        hare = g[hare];
+    }
+    while (tortoise != hare) {
+        tortoise = g[tortoise];
+        hare = g[hare];
+        m += 1;
+    }
+
+    *lambda = lam;
+    *mu = m;
+}
+
+// n steps of the generator itself
+
+static void cyc_step(msws16_t * s, const cyc_param_t * param, uint64_t n)
+{
+    uint64_t k;
+
+    if (param->complement) {
+        for (k = 0; k < n; ++k) msws16(s,param->S,param->shift,1);
+    } else {
+        for (k = 0; k < n; ++k) msws16(s,param->S,param->shift,0);
+    }
+}
+
+static uint16_t g_pow(const uint16_t * g, uint16_t x, uint32_t k)
+{
+    while (k--) {
+        x = g[x];
+    }
+    return x;
+}
+
+static int cmp_desc(const void * a, const void * b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x < y) - (x > y);
+}
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static void analyze(const char * name, const cyc_param_t * param, uint16_t x0, uint16_t w0, unsigned nthreads)
+{
+    static uint16_t g[CYC_N];
+    static uint32_t mark[CYC_N], lens[CYC_N];
+    cyc_job_t jobs[MAX_THREADS];
+    uint32_t x, y, z, ncycles = 0, cyclic = 0, lam_g, mu_g, L, i;
+    uint16_t inv, k0;
+    uint64_t lambda, t0, c;
+    msws16_t a, b;
+    double t;
+    unsigned j;
+
+    // 1. the return map g, in parallel across the start values x
+
+    t = now_sec();
+    for (j = 0; j < nthreads; ++j) {
+        jobs[j].param = param;
+        jobs[j].g = g;
+        jobs[j].begin = CYC_N * j / nthreads;
+        jobs[j].end = CYC_N * (j+1) / nthreads;
+    }
+    run_jobs(cyc_worker,jobs,sizeof(jobs[0]),nthreads);
+    t = now_sec() - t;
+
+    printf("**** %s: S=0x%04x, shift=%d, complement=%d: 2^32 steps in %.2fs (%.0f Msteps/s, %u threads)\n",
+        name, param->S, param->shift, param->complement, t, 4294967296.0/t/1e6, nthreads);
+
+    // 2. every cycle of g: walk from each unvisited x, marking the path with
+    // its own id; a path that runs into itself has found a new cycle
+
+    memset(mark,0,sizeof(mark));
+    for (x = 0; x < CYC_N; ++x) {
+        if (mark[x]) {
+            continue;
+        }
+        for (y = x; !mark[y]; y = g[y]) {
+            mark[y] = x + 1;
+        }
+        if (mark[y] == x + 1) {
+            for (L = 1, z = g[y]; z != y; z = g[z]) {
+                ++L;
+            }
+            lens[ncycles++] = L;
+            cyclic += L;
+        }
+    }
+    qsort(lens,ncycles,sizeof(lens[0]),cmp_desc);
+
+    printf("cycles: %u, states on cycles: %u * 2^16 = %.4f%% of 2^32\n",
+        ncycles, cyclic, 100.0*cyclic/CYC_N);
+    printf("cycle lengths: 2^16 * {");
+    for (i = 0; i < ncycles && i < 16; ++i) {
+        printf("%s%u", i ? ", " : "", lens[i]);
+    }
+    printf("%s}\n", ncycles > 16 ? ", ..." : "");
+
+    // 3. from the start state: step to w = 0, Brent on g, then the exact tail
+
+    inv = param->S; // S^-1 mod 2^16 by Newton: each step doubles the correct bits
+    for (i = 0; i < 4; ++i) {
+        inv = (uint16_t)((uint32_t)inv * (2 - (uint32_t)param->S*inv)); // in uint32_t: no int overflow
+    }
+    k0 = (uint16_t)((0 - (uint32_t)w0) * inv); // w0 + k0*S == 0
+
+    a.x = x0; a.w = w0;
+    cyc_step(&a,param,k0);
+    brent(g,a.x,&lam_g,&mu_g);
+    lambda = (uint64_t)lam_g * CYC_N;
+
+    // the tail is in (t0, t0 + 2^16]: compare the state at t0 with the state
+    // one period later, stepping both until they meet
+    if (mu_g == 0) {
+        t0 = 0;
+        b.x = g_pow(g,a.x,lam_g - 1); b.w = 0;
+        cyc_step(&b,param,CYC_N - k0);
+        a.x = x0; a.w = w0;
+    } else {
+        t0 = k0 + (uint64_t)CYC_N*(mu_g - 1);
+        b.x = g_pow(g,a.x,mu_g - 1 + lam_g); b.w = 0;
+        a.x = g_pow(g,a.x,mu_g - 1); a.w = 0;
+    }
+    for (c = 0; a.x != b.x || a.w != b.w; ++c) {
+        cyc_step(&a,param,1);
+        cyc_step(&b,param,1);
+    }
+
+    printf("start (x=%u, w=%u): period %llu = 2^16 * %u steps, tail %llu steps\n\n",
+        x0, w0, (unsigned long long)lambda, lam_g, (unsigned long long)(t0 + c));
+}
+
+int main(int argc, char * argv[])
+{
+    cyc_param_t param = { 0, 5, 0 };
+    unsigned nthreads = 0;
+    uint16_t x0 = 0, w0 = 0;
+    int opt, have_S = 0;
+
+    while ((opt = getopt(argc,argv,"S:cr:x:w:t:")) != -1) {
+        switch (opt) {
+        case 'S': param.S = (uint16_t)strtoul(optarg,0,0); have_S = 1; break;
+        case 'c': param.complement = 1; break;
+        case 'r': param.shift = (uint16_t)atoi(optarg); break;
+        case 'x': x0 = (uint16_t)strtoul(optarg,0,0); break;
+        case 'w': w0 = (uint16_t)strtoul(optarg,0,0); break;
+        case 't': nthreads = atoi(optarg); break;
+        default:
+            fprintf(stderr,"usage: see header of weyl-cycles.c\n");
+            return 1;
+        }
+    }
+    if (have_S && (param.S & 1) == 0) {
+        fprintf(stderr,"E: S must be odd\n");
+        return 1;
+    }
+    if (nthreads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = ncpu > 0 ? (unsigned)ncpu : 1;
+    }
+    if (nthreads > MAX_THREADS) {
+        nthreads = MAX_THREADS;
+    }
+
+    if (have_S) {
+        analyze("S",&param,x0,w0,nthreads);
+    } else {
+        const char * names[4] = { "1a", "1b", "2a", "2b" };
+        const uint16_t S[4] = { S1, S1, S2, S2 };
+        unsigned v;
+
+        for (v = 0; v < 4; ++v) {
+            param.S = S[v];
+            param.complement = v & 1;
+            analyze(names[v],&param,x0,w0,nthreads);
+        }
+    }
+
+    return 0;
+}
@@ -8,12 +8,31 @@ COPYRIGHT (c) 2017 Avraham Bernstein, Jerusalem ISRAEL. All rights reserved.
 LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
 REVISION HISTORY:
 2017-11-26: 1.0.0: AB: original
+2026-10-18: 1.1.0: explicit msws16_t state; the variants run concurrently, with live steps/s and ETA
+2026-10-18: 1.2.0: generic msws16(), WEYL_PRNG_NO_MAIN for weyl-cycles.c
+2026-10-18: 1.3.0: msws16v(): MSWS16_W streams in the lanes of an AVX2/AVX-512BW vector
+2026-10-18: 1.4.0: the histogram with hist.h: banked, 64-bit totals
+2026-10-18: 1.5.0: msws1a() .. msws2b() are msws16(); the compile-time family is msws.h
+2026-10-18: 1.5.1: msws16() is MSWS_STEP_() of msws.h
+2026-10-18: 1.5.2: full jobs[] initializers; no progress line for 0 steps
+================================================================================
+USAGE: weyl-prng [shift [steps]]     # default: 5 0x7fffffff
+BUILD: cc -O2 -pthread -o weyl-prng weyl-prng.c
 ================================================================================
 */
 #include <stdint.h>
+#include <stdlib.h>
 #include <limits.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "msws.h"
 
 const int N = 0x7fffffff;
 
@@ -29,137 +48,241 @@ inline static uint16_t rotr16 (uint16_t value, uint16_t count) {
 static const uint16_t S1 = 0xabc1; // S is odd
 static const uint16_t S2 = 0xff7;
 
-inline static uint8_t msws1a(uint16_t shift) {
-    static uint16_t x = 0, w = 0;
-
-    x *= x; x += (w += S1);
-    x = rotr16(x,shift); // rotate 4-15
-
-    // x ^= x >> 1;
-    // x = lcg(x);
-    // if (__builtin_popcount(x) & 1) x = ~x;
+typedef struct { uint16_t x, w; } msws16_t; // 32 bits of state, initially 0
 
-    return x;
-}
+// any odd S and shift, with or without the parity complement; returns all
+// 16 bits. The step is the one of the compile-time family in msws.h, with a
+// run-time S and shift. The gray step x ^= x >> 1 that was tried in the
+// variants is a finalizer of msws16v() and of msws.h
 
-inline static uint8_t msws1b(uint16_t shift) {
-    static uint16_t x = 0, w = 0;
+__attribute__((always_inline))
+inline static uint16_t msws16(msws16_t * s, uint16_t S, uint16_t shift, int complement) {
+    uint16_t x = s->x, w = s->w;
 
-    x *= x; x += (w += S1);
-    x = rotr16(x,shift); // rotate 4-15
-    if (__builtin_popcount(x) & 1) x = ~x;
+    MSWS_STEP_(16,S,shift & 15)
+    if (complement && MSWS_PARITY(16)(x)) x = ~x;
 
+    s->x = x;
+    s->w = w;
     return x;
 }
 
-inline static uint8_t msws2a(uint16_t shift) {
-    static uint16_t x = 0, w = 0;
-
-    x *= x; x += (w += S2);
-    x = rotr16(x,shift); // rotate 4-15
-
-    // x ^= x >> 1;
-    // x = lcg(x);
-    // if (__builtin_popcount(x) & 1) x = ~x;
-
-    return x;
+// the 4 variants: the low byte of msws16(); the complement feeds back
+
+inline static uint8_t msws1a(msws16_t * s, uint16_t shift) { return (uint8_t)msws16(s,S1,shift,0); }
+inline static uint8_t msws1b(msws16_t * s, uint16_t shift) { return (uint8_t)msws16(s,S1,shift,1); }
+inline static uint8_t msws2a(msws16_t * s, uint16_t shift) { return (uint8_t)msws16(s,S2,shift,0); }
+inline static uint8_t msws2b(msws16_t * s, uint16_t shift) { return (uint8_t)msws16(s,S2,shift,1); }
+
+// vectorized msws16(): MSWS16_W independent streams, each with its own S,
+// shift and parity complement, one per 16-bit lane. The rotate by a per lane
+// count is native with AVX-512BW (vpsrlvw/vpsllvw). AVX2 has no 16-bit
+// variable shift, so there rotr(x,r) = x*m | mulhi(x,m) with m = 2^(16-r),
+// i.e. the low and high halves of x << (16-r); m = 1 for r = 0. The parity
+// is the xor fold of the lane. Without either, a scalar loop over the lanes.
+
+#if defined(__AVX512BW__)
+#define MSWS16_W 32
+#elif defined(__AVX2__)
+#define MSWS16_W 16
+#else
+#define MSWS16_W 8
+#endif
+
+#if defined(__AVX2__)
+typedef uint16_t msws16v_vec_t __attribute__((vector_size(2*MSWS16_W)));
+#else
+typedef uint16_t msws16v_vec_t[MSWS16_W];
+#endif
+
+typedef struct {
+    msws16v_vec_t x, w, S;
+    msws16v_vec_t shift;        // 0-15
+    msws16v_vec_t m;            // 2^((16 - shift) & 15)
+    msws16v_vec_t cmask;        // 0xffff: parity complement
+} msws16v_t;
+
+inline static void msws16v_set(msws16v_t * s, unsigned lane, uint16_t x, uint16_t w, uint16_t S, uint16_t shift, int complement) {
+    s->x[lane] = x;
+    s->w[lane] = w;
+    s->S[lane] = S;
+    s->shift[lane] = shift & 15;
+    s->m[lane] = (uint16_t)(1u << ((16 - shift) & 15));
+    s->cmask[lane] = complement ? 0xffff : 0;
 }
 
-inline static uint8_t msws2b(uint16_t shift) {
-    static uint16_t x = 0, w = 0;
-
-    x *= x; x += (w += S2);
-    x = rotr16(x,shift); // rotate 4-15
-    if (__builtin_popcount(x) & 1) x = ~x;
-
-    return x;
+// one step of every lane; gray (a constant) adds the x ^= x >> 1 that is
+// commented out in the variants above, before the complement
+
+__attribute__((always_inline))
+inline static void msws16v(msws16v_t * s, const int gray) {
+#if defined(__AVX2__)
+    msws16v_vec_t x = s->x, p;
+
+    x *= x; x += (s->w += s->S);
+#if defined(__AVX512BW__)
+    x = (x >> s->shift) | (x << ((-s->shift) & 15));
+#else
+    x = (x * s->m) | (msws16v_vec_t)_mm256_mulhi_epu16((__m256i)x,(__m256i)s->m);
+#endif
+    if (gray) x ^= x >> 1;
+    p = x ^ (x >> 8); p ^= p >> 4; p ^= p >> 2; p ^= p >> 1;
+    x ^= -(p & 1) & s->cmask;
+
+    s->x = x;
+#else
+    for (unsigned l = 0; l < MSWS16_W; ++l) {
+        uint16_t x = s->x[l];
+
+        x *= x; x += (s->w[l] += s->S[l]);
+        x = rotr16(x,s->shift[l]);
+        if (gray) x ^= x >> 1;
+        if (__builtin_popcount(x) & 1) x ^= s->cmask[l];
+
+        s->x[l] = x;
+    }
+#endif
 }
 
-int main()
-{
-    int freq_array[256];
-    int min, max;
-    const uint16_t SHIFT = 5;
-
-    memset(freq_array,0,sizeof(freq_array));
-    min=N, max = 0;
+#ifndef WEYL_PRNG_NO_MAIN // i.e. when included by a tool
 
-    for (int i = 0; i < N; ++i) {
-        if ((i & 0xffffff) == 0) { printf("."); fflush(stdout); }
-        uint8_t y = msws1a(SHIFT);
-        ++freq_array[y];
-    }
+#include "hist.h"
 
-    printf("\n**** 1a: SHIFT=%2d, S=0x%04x\n",(int)SHIFT, (int)S1);
+typedef uint8_t (*msws_fn_t)(msws16_t * s, uint16_t shift);
 
-    for (int i = 0; i <= 255; ++i) {
-        int f = freq_array[i];
-        if (f < min) min = f;
-        if (f > max) max = f;
-        printf("%3d, %9d\n",i,f);
-    }
+typedef struct {
+    const char * name;
+    msws_fn_t fn;
+    uint16_t S;
+    uint16_t shift;
+    uint64_t steps;
+    uint64_t done;              // progress, for the reporter
+    hist_t freq;                // this thread's histogram
+} msws_job_t;
 
-    printf("min = %9d, max = %9d\n", min, max);
+#define PROGRESS_STEP (1 << 24)
 
-    memset(freq_array,0,sizeof(freq_array));
-    min=N, max = 0;
+// always inlined with a constant fn, so that the state stays in registers;
+// successive outputs are counted in different banks, so that a repeated
+// output does not wait for its previous increment
 
-    for (int i = 0; i < N; ++i) {
-        if ((i & 0xffffff) == 0) { printf("."); fflush(stdout); }
-        uint8_t y = msws1b(SHIFT);
-        ++freq_array[y];
+__attribute__((always_inline))
+inline static void msws_loop(msws_fn_t fn, msws16_t * st, uint16_t shift, uint64_t n, hist_t * freq)
+{
+    uint32_t * b0 = hist_bank(freq,0), * b1 = hist_bank(freq,1), * b2 = hist_bank(freq,2), * b3 = hist_bank(freq,3);
+    msws16_t s = *st;
+    size_t m, i;
+
+    for (uint64_t k = 0; k < n; k += m) {
+        m = n - k < HIST_CHUNK ? (size_t)(n - k) : HIST_CHUNK;
+        hist_reserve(freq,m);
+        for (i = 0; i + 4 <= m; i += 4) {
+            ++b0[fn(&s,shift)];
+            ++b1[fn(&s,shift)];
+            ++b2[fn(&s,shift)];
+            ++b3[fn(&s,shift)];
+        }
+        for (; i < m; ++i) {
+            ++b0[fn(&s,shift)];
+        }
     }
+    *st = s;
+}
 
-    printf("\n**** 1b: SHIFT=%2d, S=0x%04x\n",(int)SHIFT, (int)S1);
-
-    for (int i = 0; i <= 255; ++i) {
-        int f = freq_array[i];
-        if (f < min) min = f;
-        if (f > max) max = f;
-        printf("%3d, %9d\n",i,f);
+static void * msws_worker(void * arg)
+{
+    msws_job_t * job = (msws_job_t *)arg;
+    msws16_t st = { 0, 0 };
+    uint64_t i, n;
+
+    for (i = 0; i < job->steps; i += n) {
+        n = job->steps - i < PROGRESS_STEP ? job->steps - i : PROGRESS_STEP;
+        if (job->fn == msws1a) msws_loop(msws1a,&st,job->shift,n,&job->freq);
+        else if (job->fn == msws1b) msws_loop(msws1b,&st,job->shift,n,&job->freq);
+        else if (job->fn == msws2a) msws_loop(msws2a,&st,job->shift,n,&job->freq);
+        else if (job->fn == msws2b) msws_loop(msws2b,&st,job->shift,n,&job->freq);
+        else msws_loop(job->fn,&st,job->shift,n,&job->freq);
+        __atomic_store_n(&job->done,i + n,__ATOMIC_RELAXED);
     }
 
-    printf("min = %9d, max = %9d\n", min, max);
+    return 0;
+}
 
-    memset(freq_array,0,sizeof(freq_array));
-    min=N, max = 0;
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
 
-    for (int i = 0; i < N; ++i) {
-        if ((i & 0xffffff) == 0) { printf("."); fflush(stdout); }
-        uint8_t y = msws2a(SHIFT);
-        ++freq_array[y];
+int main(int argc, const char * argv[])
+{
+    const uint16_t SHIFT = argc > 1 ? (uint16_t)atoi(argv[1]) : 5;
+    const uint64_t steps = argc > 2 ? strtoull(argv[2],0,0) : (uint64_t)N;
+    static msws_job_t jobs[] = {
+        { "1a", msws1a, S1, 0, 0, 0, { 0, 0, 0, 0 } },
+        { "1b", msws1b, S1, 0, 0, 0, { 0, 0, 0, 0 } },
+        { "2a", msws2a, S2, 0, 0, 0, { 0, 0, 0, 0 } },
+        { "2b", msws2b, S2, 0, 0, 0, { 0, 0, 0, 0 } },
+    };
+    const unsigned njobs = sizeof(jobs)/sizeof(jobs[0]);
+    pthread_t tid[sizeof(jobs)/sizeof(jobs[0])];
+    uint64_t done, total = njobs*steps;
+    double t0 = now_sec(), t;
+    unsigned j;
+
+    // one thread per variant: each sequence is inherently serial
+
+    for (j = 0; j < njobs; ++j) {
+        jobs[j].shift = SHIFT;
+        jobs[j].steps = steps;
+        if (hist_init(&jobs[j].freq,256) != 0) {
+            fprintf(stderr,"E: out of memory\n");
+            return 1;
+        }
+        if (pthread_create(&tid[j],0,msws_worker,&jobs[j]) != 0) {
+            fprintf(stderr,"E: pthread_create() failed\n");
+            return 1;
+        }
     }
 
-    printf("\n**** 2a: SHIFT=%2d, S=0x%04x\n",(int)SHIFT,(int)S2);
-
-    for (int i = 0; i <= 255; ++i) {
-        int f = freq_array[i];
-        if (f < min) min = f;
-        if (f > max) max = f;
-        printf("%3d, %9d\n",i,f);
+    // live progress on stderr, until every thread is done; none for 0 steps
+
+    for (done = 0; done < total; ) {
+        usleep(250000);
+        for (j = 0, done = 0; j < njobs; ++j) {
+            done += __atomic_load_n(&jobs[j].done,__ATOMIC_RELAXED);
+        }
+        t = now_sec() - t0;
+        fprintf(stderr,"\r%5.1f%%  %7.1f Msteps/s  elapsed %5.0fs  ETA %5.0fs ",
+            100.0*done/total, done/t/1e6, t, done ? t*(total - done)/done : 0.0);
+        if (done == total) {
+            fprintf(stderr,"\n");
+        }
     }
 
-    printf("min = %9d, max = %9d\n", min, max);
+    for (j = 0; j < njobs; ++j) {
+        pthread_join(tid[j],0);
+    }
 
-    memset(freq_array,0,sizeof(freq_array));
-    min=N, max = 0;
+    for (j = 0; j < njobs; ++j) {
+        uint64_t min = UINT64_MAX, max = 0;
 
-    for (int i = 0; i < N; ++i) {
-        if ((i & 0xffffff) == 0) { printf("."); fflush(stdout); }
-        uint8_t y = msws2b(SHIFT);
-        ++freq_array[y];
-    }
+        printf("\n**** %s: SHIFT=%2d, S=0x%04x\n", jobs[j].name, (int)SHIFT, (int)jobs[j].S);
 
-    printf("\n**** 2b: SHIFT=%2d, S=0x%04x\n",(int)SHIFT, (int)S2);
+        hist_flush(&jobs[j].freq);
+        for (int i = 0; i <= 255; ++i) {
+            uint64_t f = jobs[j].freq.total[i];
+            if (f < min) min = f;
+            if (f > max) max = f;
+            printf("%3d, %9llu\n",i,(unsigned long long)f);
+        }
 
-    for (int i = 0; i <= 255; ++i) {
-        int f = freq_array[i];
-        if (f < min) min = f;
-        if (f > max) max = f;
-        printf("%3d, %9d\n",i,f);
+        printf("min = %9llu, max = %9llu\n", (unsigned long long)min, (unsigned long long)max);
+        hist_free(&jobs[j].freq);
     }
 
-    printf("min = %9d, max = %9d\n", min, max);
-
     return 0;
 }
+
+#endif // WEYL_PRNG_NO_MAIN
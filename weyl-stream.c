@@ -0,0 +1,266 @@
+/*
+FILE: weyl-stream.c
+DESCRIP: raw binary output of a generator of the msws.h registry, for external PRNG test suites
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+2026-10-18: 1.1.0: the generators are the instances of msws.h: -l; no -r, -s
+2026-10-18: 1.1.1: write() only: vmsplice() let a reader that splice()s see reused buffers
+2026-10-18: 1.1.2: the errno of a failed close() is saved before it is reported
+================================================================================
+USAGE: weyl-stream [-l] [-n bytes] [-o file] [-v] [generator]
+    generator   an instance of MSWS_REGISTRY in msws.h, default rnd32; e.g.
+                1a, 1b, 2a, 2b (weyl-prng.c, shift 5)
+    -l          list the generators and their parameters
+    -n bytes    stop after this many bytes, default 0: until the reader exits
+    -o file     default stdout
+    -v          bytes, time and rate on stderr at the end
+    e.g. weyl-stream 1b | RNG_test stdin8        (PractRand)
+         weyl-stream rnd32 | dieharder -a -g 200
+BUILD: cc -O2 -pthread -o weyl-stream weyl-stream.c
+    The stream is the exact sequence of the generator from the zero state, as
+    in weyl-prng.c and weyl-battery.c: one output of out_bits per step (rnd32
+    32, the msws16 variants 8), in native (i.e. little endian) byte order.
+    The rotation and S are compile-time parameters: another one is another
+    line in the registry.
+    The main thread fills a ring of page aligned buffers of STREAM_BUF bytes
+    while a writer thread drains it with write(), so generation and I/O
+    overlap. If the output is a pipe, it is enlarged to STREAM_PIPE bytes, so
+    the writer blocks less often. There is no vmsplice(): it only references
+    the pages, and a reader that splice()s them on (e.g. into a file) still
+    holds them after they are consumed from the pipe, so a reused buffer
+    would change data already "read"; the copy of write() costs little next
+    to any test suite. The bound is the generator, which is serial: the
+    stream runs at the rate of its fill() alone, e.g. rnd32 ~1.9 GB/s and
+    the msws16 variants 0.2-0.5 GB/s to /dev/null on one core.
+    The reader closing the pipe (EPIPE) is the normal end of an unlimited run.
+================================================================================
+*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // F_SETPIPE_SZ
+#endif
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "msws.h"
+
+#define STREAM_BUF      (1 << 18)       // bytes per buffer: fits in L2 while it is filled
+#define STREAM_PIPE     (1 << 20)       // requested pipe size; the default max of /proc/sys/fs/pipe-max-size
+#define STREAM_ALIGN    4096
+#define STREAM_NBUF     2
+
+// the ring: the producer fills buffer (filled % STREAM_NBUF) once filled <
+// written + STREAM_NBUF; the writer drains buffer (written % STREAM_NBUF) once
+// written < filled
+
+typedef struct {
+    int fd;
+    uint8_t * buf[STREAM_NBUF];
+    size_t len[STREAM_NBUF];
+    uint64_t filled, written;
+    uint64_t bytes;             // written out
+    int eof;                    // the producer is done
+    int err;                    // the writer stopped: errno, or EPIPE
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} stream_t;
+
+// all of p[0..n-1] to fd; returns 0 or errno
+
+static int stream_out(stream_t * st, const uint8_t * p, size_t n)
+{
+    while (n > 0) {
+        ssize_t k = write(st->fd,p,n);
+
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        p += k;
+        n -= k;
+        st->bytes += k;
+    }
+    return 0;
+}
+
+static void * stream_writer(void * arg)
+{
+    stream_t * st = (stream_t *)arg;
+    uint64_t i;
+    int err;
+
+    for (;;) {
+        pthread_mutex_lock(&st->lock);
+        while (st->written == st->filled && !st->eof) {
+            pthread_cond_wait(&st->cond,&st->lock);
+        }
+        if (st->written == st->filled) {
+            pthread_mutex_unlock(&st->lock);
+            return 0;
+        }
+        i = st->written;
+        pthread_mutex_unlock(&st->lock);
+
+        err = stream_out(st,st->buf[i % STREAM_NBUF],st->len[i % STREAM_NBUF]);
+
+        pthread_mutex_lock(&st->lock);
+        st->written = i + 1;
+        st->err = err;
+        pthread_cond_signal(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        if (err) {
+            return 0;
+        }
+    }
+}
+
+// the next free buffer, or 0 if the writer has stopped
+
+static uint8_t * stream_acquire(stream_t * st)
+{
+    uint8_t * p = 0;
+
+    pthread_mutex_lock(&st->lock);
+    while (st->filled - st->written >= STREAM_NBUF && !st->err) {
+        pthread_cond_wait(&st->cond,&st->lock);
+    }
+    if (!st->err) {
+        p = st->buf[st->filled % STREAM_NBUF];
+    }
+    pthread_mutex_unlock(&st->lock);
+    return p;
+}
+
+static void stream_commit(stream_t * st, size_t n)
+{
+    pthread_mutex_lock(&st->lock);
+    st->len[st->filled % STREAM_NBUF] = n;
+    st->filled += 1;
+    pthread_cond_signal(&st->cond);
+    pthread_mutex_unlock(&st->lock);
+}
+
+static void stream_close(stream_t * st)
+{
+    pthread_mutex_lock(&st->lock);
+    st->eof = 1;
+    pthread_cond_signal(&st->cond);
+    pthread_mutex_unlock(&st->lock);
+}
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+int main(int argc, char * argv[])
+{
+    const msws_info_t * gen = msws_find("rnd32");
+    const char * path = 0;
+    uint64_t limit = 0, total;
+    msws_t s = { 0, 0 };
+    size_t out_bytes;
+    stream_t st;
+    pthread_t tid;
+    struct stat sb;
+    uint8_t * p;
+    size_t n;
+    double t;
+    unsigned j;
+    int opt, verbose = 0, err;
+
+    while ((opt = getopt(argc,argv,"ln:o:v")) != -1) {
+        switch (opt) {
+        case 'l':
+            for (j = 0; j < MSWS_NREGISTRY; ++j) {
+                const msws_info_t * m = &msws_registry[j];
+                printf("%-8s W=%-2u out=%-2u S=0x%0*llx shift=%-2u gray=%u complement=%u\n",
+                    m->name, m->width, m->out_bits, (int)m->width/4, (unsigned long long)m->S, m->shift, m->gray, m->complement);
+            }
+            return 0;
+        case 'n': limit = strtoull(optarg,0,0); break;
+        case 'o': path = optarg; break;
+        case 'v': verbose = 1; break;
+        default:
+            fprintf(stderr,"usage: see header of weyl-stream.c\n");
+            return 1;
+        }
+    }
+    if (optind + 1 < argc) {
+        fprintf(stderr,"E: one generator at a time\n");
+        return 1;
+    }
+    if (optind < argc && (gen = msws_find(argv[optind])) == 0) {
+        fprintf(stderr,"E: unknown generator %s: see -l\n", argv[optind]);
+        return 1;
+    }
+    out_bytes = gen->out_bits / 8;
+
+    memset(&st,0,sizeof(st));
+    st.fd = 1;
+    if (path && (st.fd = open(path,O_WRONLY | O_CREAT | O_TRUNC,0644)) < 0) {
+        fprintf(stderr,"E: cannot open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    if (fstat(st.fd,&sb) == 0 && S_ISFIFO(sb.st_mode)) {
+        (void)fcntl(st.fd,F_SETPIPE_SZ,STREAM_PIPE); // may be refused: keep the current size
+    }
+    for (j = 0; j < STREAM_NBUF; ++j) {
+        if (posix_memalign((void **)&st.buf[j],STREAM_ALIGN,STREAM_BUF) != 0) {
+            fprintf(stderr,"E: out of memory\n");
+            return 1;
+        }
+    }
+    signal(SIGPIPE,SIG_IGN); // EPIPE instead
+    pthread_mutex_init(&st.lock,0);
+    pthread_cond_init(&st.cond,0);
+    if (pthread_create(&tid,0,stream_writer,&st) != 0) {
+        fprintf(stderr,"E: pthread_create() failed\n");
+        return 1;
+    }
+
+    t = now_sec();
+    for (total = 0; limit == 0 || total < limit; total += n) {
+        n = limit == 0 || limit - total > STREAM_BUF ? STREAM_BUF : (size_t)(limit - total);
+        if ((p = stream_acquire(&st)) == 0) {
+            break;
+        }
+        gen->fill(&s,p,(n + out_bytes - 1) / out_bytes); // the buffer is a whole number of outputs
+        stream_commit(&st,n);
+    }
+    stream_close(&st);
+    pthread_join(tid,0);
+    t = now_sec() - t;
+
+    err = st.err == EPIPE && limit == 0 ? 0 : st.err;
+    if (err) {
+        fprintf(stderr,"E: write failed: %s\n", strerror(err));
+    }
+    if (path && close(st.fd) != 0 && !err) {
+        err = errno; // before fprintf(), which may change it
+        fprintf(stderr,"E: close failed: %s\n", strerror(err));
+    }
+    if (verbose) {
+        fprintf(stderr,"%s: %llu bytes in %.2fs: %.0f MB/s\n",
+            gen->name, (unsigned long long)st.bytes, t, st.bytes/t/1e6);
+    }
+
+    for (j = 0; j < STREAM_NBUF; ++j) {
+        free(st.buf[j]);
+    }
+
+    return err != 0;
+}
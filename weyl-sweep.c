@@ -0,0 +1,511 @@
+/*
+FILE: weyl-sweep.c
+DESCRIP: resumable parallel sweep of the msws16 Weyl constants, rotations and shapes
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+2026-10-18: 1.1.0: MSWS16_W configurations at a time in the lanes of msws16v()
+2026-10-18: 1.1.1: -R opens the checkpoint read-only; a damaged checkpoint is refused, not truncated
+2026-10-18: 1.1.2: the battery is fed the distinct batches only: a bitmap of the x at w = 0 instead of Brent
+================================================================================
+USAGE: weyl-sweep [-n log2_steps] [-f file] [-t threads] [-u units] [-k top] [-R]
+    -n log2     generator steps per configuration = 2^log2, default 20
+    -f file     checkpoint file, default weyl-sweep.ckpt
+    -t threads  default: one per online cpu
+    -u units    stop after this many work units (this run), default all
+    -k top      number of ranked candidates to print, default 32
+    -R          only rank the configurations in the checkpoint file, which
+                is opened read-only
+BUILD: cc -O3 -march=native -pthread -o weyl-sweep weyl-sweep.c -lm
+    The grid: the 32768 odd S x the rotations 4-15 x 4 shapes, where the
+    shapes are the variants of weyl-prng.c with and without the popcount
+    parity complement (a, b), and the same after the commented out gray code
+    step x ^= x >> 1 (ga, gb); all of them feed back into x. That is 1.5M
+    configurations, in work units of 256 consecutive S for one (shape,
+    rotation), pulled by the threads from a shared counter, round robin over
+    the (shape, rotation) pairs.
+    Each configuration runs from (0, 0) for 2^log2 steps through the
+    streaming battery of weyl-battery.c; 16 (AVX2) or 32 (AVX-512BW)
+    configurations, with consecutive S, step together in msws16v(). The generator runs in batches of
+    2^16 steps, the period of w, so a batch is determined by the x at w = 0
+    where it starts. A bitmap of those x per lane marks the first batch that
+    repeats an earlier one: the battery is fed exactly the distinct batches
+    before it (the tail and one period, never a repeat), and the period is
+    then counted, without the battery, as the batches until that x recurs,
+    which is at most as many batches again as the budget. (In fact the
+    msws16 state collapses onto a short cycle within a few hundred steps for
+    most configurations, so the period is the first thing to rank by.)
+    Every completed unit is appended to the checkpoint file and flushed. On
+    restart the file is read back (a torn last record is dropped) and only
+    the missing units are run: kill it at any time. A file that is not a
+    checkpoint of the same -n, or has a corrupt record before its end, is
+    refused and left untouched.
+    The ranking: configurations that did not cycle first, then the longer
+    periods, then by pmin, the worst of the battery p-values mapped to
+    2*min(p, 1-p), i.e. 1 is best.
+================================================================================
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WEYL_PRNG_NO_MAIN
+#define WEYL_BATTERY_NO_MAIN
+#include "weyl-battery.c"
+
+#define SWEEP_NS        32768           // odd 16-bit S
+#define SWEEP_ROT_MIN   4
+#define SWEEP_NROT      12              // rotations 4-15
+#define SWEEP_NSHAPES   4
+#define SWEEP_NCONF     (SWEEP_NSHAPES*SWEEP_NROT*SWEEP_NS)
+#define SWEEP_UNIT      256             // configurations per work unit
+#define SWEEP_NUNITS    (SWEEP_NCONF/SWEEP_UNIT)
+#define SWEEP_BATCH     65536           // steps per batch = the period of w
+#define SWEEP_TILE      256
+#define SWEEP_SEEN      (65536/64)      // words of the bitmap of the x at w = 0, per lane
+#define SWEEP_MAGIC     "WSWEEP1"
+#define MAX_THREADS     64
+
+static const char * shape_names[SWEEP_NSHAPES] = { "a", "b", "ga", "gb" };
+
+typedef struct {
+    float pmin;                         // min over the tests of 2*min(p, 1-p)
+    uint16_t fails;                     // tests with p < 1e-6 or p > 1 - 1e-6
+    uint16_t pad;
+    uint32_t period;                    // from (0, 0), in units of 2^16 steps; 0: > the budget
+} sweep_res_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t log2_steps, unit;
+} sweep_hdr_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t pad;
+    sweep_res_t res[SWEEP_UNIT];
+} sweep_rec_t;
+
+typedef struct {
+    unsigned log2_steps;
+    unsigned max_units;                 // this run
+    FILE * ckpt;
+    sweep_res_t * res;                  // [SWEEP_NCONF]
+    uint8_t done[SWEEP_NUNITS];
+    unsigned next, started, nexited;    // atomic
+    unsigned ndone;
+    pthread_mutex_t lock;
+} sweep_t;
+
+typedef struct {
+    sweep_t * sw;
+    battery_t * b;                      // [MSWS16_W]
+    uint32_t * buf;                     // [MSWS16_W][SWEEP_BATCH/4]
+    uint64_t * seen;                    // [MSWS16_W][SWEEP_SEEN]
+} sweep_job_t;
+
+static void sweep_conf(uint32_t c, unsigned * shape, unsigned * shift, uint16_t * S)
+{
+    *shape = c / (SWEEP_NROT*SWEEP_NS);
+    *shift = SWEEP_ROT_MIN + c / SWEEP_NS % SWEEP_NROT;
+    *S = (uint16_t)(2*(c % SWEEP_NS) + 1);
+}
+
+// the configurations c0 .. c0+n-1 (n <= MSWS16_W, same shape and rotation) in
+// the lanes of msws16v(); the output of lane l goes to buf + l*SWEEP_BATCH/4
+// and its battery b[l], and seen + l*SWEEP_SEEN has its bit x set once a
+// batch has started at x. gray is a constant.
+
+__attribute__((always_inline))
+inline static void sweep_run(battery_t * b, uint32_t * buf, uint64_t * seen, uint32_t c0, unsigned n,
+    const int gray, uint64_t nbatches, sweep_res_t * res)
+{
+    enum { FEED, COUNT, DONE };
+    bat_result_t r[BAT_NTESTS];
+    msws16v_t s;
+    uint8_t phase[MSWS16_W], tile[SWEEP_TILE][MSWS16_W];
+    uint16_t repeat[MSWS16_W];
+    uint32_t count[MSWS16_W];
+    unsigned l, k, j, shape, shift, live = n;
+    uint16_t S;
+    uint64_t i;
+
+    memset(seen,0,sizeof(seen[0]) * MSWS16_W*SWEEP_SEEN);
+    for (l = 0; l < MSWS16_W; ++l) {
+        sweep_conf(c0 + (l < n ? l : 0),&shape,&shift,&S);
+        msws16v_set(&s,l,0,0,S,shift,shape & 1);
+        seen[l*SWEEP_SEEN] = 1; // batch 0 starts at x = 0
+        phase[l] = l < n ? FEED : DONE;
+    }
+    memset(res,0,n*sizeof(res[0]));
+
+    for (l = 0; l < n; ++l) {
+        battery_init(&b[l]);
+    }
+
+    for (i = 0; live > 0; ++i) {
+        // a tile of SWEEP_TILE steps x the lanes in L1, then transposed to
+        // the lane buffers: storing every step straight into 16 or 32
+        // buffers 64KB apart is ~6x slower
+        for (k = 0; k < SWEEP_BATCH; k += SWEEP_TILE) {
+            for (j = 0; j < SWEEP_TILE; ++j) {
+                msws16v(&s,gray);
+                for (l = 0; l < MSWS16_W; ++l) {
+                    tile[j][l] = (uint8_t)s.x[l];
+                }
+            }
+            for (l = 0; l < MSWS16_W; ++l) {
+                uint8_t * p = (uint8_t *)buf + l*SWEEP_BATCH + k;
+                for (j = 0; j < SWEEP_TILE; ++j) {
+                    p[j] = tile[j][l];
+                }
+            }
+        }
+        // w == 0 again: s.x starts batch i + 1
+        for (l = 0; l < n; ++l) {
+            const uint16_t x = (uint16_t)s.x[l];
+            uint64_t * bits = seen + l*SWEEP_SEEN;
+
+            if (phase[l] == FEED) {
+                battery_feed(&b[l],buf + l*SWEEP_BATCH/4,SWEEP_BATCH/4);
+                if (bits[x/64] >> x%64 & 1) {
+                    phase[l] = COUNT; // batch i + 1 would repeat: the period is the distance to the next x
+                    repeat[l] = x;
+                    count[l] = 0;
+                } else if (i + 1 == nbatches) {
+                    phase[l] = DONE; // no repeat within the budget: period 0
+                    --live;
+                } else {
+                    bits[x/64] |= (uint64_t)1 << x%64;
+                }
+            } else if (phase[l] == COUNT && (++count[l], x == repeat[l])) {
+                res[l].period = count[l];
+                phase[l] = DONE;
+                --live;
+            }
+        }
+    }
+
+    for (l = 0; l < n; ++l) {
+        battery_eval(&b[l],r);
+        res[l].pmin = 1;
+        for (k = 0; k < BAT_NTESTS; ++k) {
+            if (r[k].p >= 0) {
+                double q = 2*(r[k].p < 1 - r[k].p ? r[k].p : 1 - r[k].p);
+                res[l].pmin = q < res[l].pmin ? q : res[l].pmin;
+                res[l].fails += bat_fail(r[k].p);
+            }
+        }
+    }
+}
+
+static void * sweep_worker(void * arg)
+{
+    sweep_job_t * job = (sweep_job_t *)arg;
+    sweep_t * sw = job->sw;
+    const uint64_t nbatches = ((uint64_t)1 << sw->log2_steps) / SWEEP_BATCH;
+    unsigned u, k;
+
+    for (;;) {
+        sweep_rec_t r;
+
+        // round robin over the (shape, rotation) pairs, so that a partial
+        // sweep already covers the whole grid
+        u = __atomic_fetch_add(&sw->next,1,__ATOMIC_RELAXED);
+        if (u >= SWEEP_NUNITS) {
+            break;
+        }
+        u = u % (SWEEP_NSHAPES*SWEEP_NROT) * (SWEEP_NS/SWEEP_UNIT) + u / (SWEEP_NSHAPES*SWEEP_NROT);
+        if (sw->done[u]) {
+            continue;
+        }
+        if (__atomic_fetch_add(&sw->started,1,__ATOMIC_RELAXED) >= sw->max_units) {
+            break;
+        }
+
+        memset(&r,0,sizeof(r));
+        r.id = u;
+        for (k = 0; k < SWEEP_UNIT; k += MSWS16_W) {
+            const uint32_t c = u*SWEEP_UNIT + k;
+            const unsigned n = SWEEP_UNIT - k < MSWS16_W ? SWEEP_UNIT - k : MSWS16_W;
+            if (c / (SWEEP_NROT*SWEEP_NS) & 2) {
+                sweep_run(job->b,job->buf,job->seen,c,n,1,nbatches,&r.res[k]);
+            } else {
+                sweep_run(job->b,job->buf,job->seen,c,n,0,nbatches,&r.res[k]);
+            }
+        }
+
+        pthread_mutex_lock(&sw->lock);
+        if (fwrite(&r,sizeof(r),1,sw->ckpt) != 1 || fflush(sw->ckpt) != 0) {
+            fprintf(stderr,"\nE: checkpoint write failed\n");
+            exit(1);
+        }
+        memcpy(sw->res + u*SWEEP_UNIT,r.res,sizeof(r.res));
+        sw->done[u] = 1;
+        ++sw->ndone;
+        pthread_mutex_unlock(&sw->lock);
+    }
+
+    __atomic_fetch_add(&sw->nexited,1,__ATOMIC_RELAXED);
+    return 0;
+}
+
+// read back the completed units, drop a torn last record, and reopen the
+// file for appending, unless read_only; returns 0, or -1 for a file of other
+// parameters, or one that is not a checkpoint: it is never truncated then
+
+static int sweep_open(sweep_t * sw, const char * path, int read_only)
+{
+    sweep_hdr_t hdr, h;
+    sweep_rec_t rec;
+    long good = 0, size = 0, nrec = 0;
+    FILE * f;
+
+    memset(&hdr,0,sizeof(hdr));
+    memcpy(hdr.magic,SWEEP_MAGIC,sizeof(SWEEP_MAGIC));
+    hdr.log2_steps = sw->log2_steps;
+    hdr.unit = SWEEP_UNIT;
+
+    if ((f = fopen(path,"rb")) != 0) {
+        if (fseek(f,0,SEEK_END) != 0 || (size = ftell(f)) < 0 || fseek(f,0,SEEK_SET) != 0) {
+            fprintf(stderr,"E: %s: cannot seek\n", path);
+            fclose(f);
+            return -1;
+        }
+        if (size > 0 && (fread(&h,sizeof(h),1,f) != 1 || memcmp(&h,&hdr,sizeof(h)) != 0)) {
+            fprintf(stderr,"E: %s: not a checkpoint of this sweep, or of another -n\n", path);
+            fclose(f);
+            return -1;
+        }
+        good = size > 0 ? (long)sizeof(hdr) : 0;
+        while (size > 0 && fread(&rec,sizeof(rec),1,f) == 1) {
+            if (rec.id >= SWEEP_NUNITS) {
+                break;
+            }
+            if (!sw->done[rec.id]) {
+                memcpy(sw->res + rec.id*SWEEP_UNIT,rec.res,sizeof(rec.res));
+                sw->done[rec.id] = 1;
+                ++sw->ndone;
+            }
+            good += sizeof(rec);
+            ++nrec;
+        }
+        fclose(f);
+        // only a torn last record is dropped; anything else after the good
+        // records is a damaged file, which is left as it is
+        if (size - good >= (long)sizeof(rec)) {
+            fprintf(stderr,"E: %s: %ld good records, then a corrupt one: %ld bytes (~%ld records) would be dropped\n",
+                path, nrec, size - good, (size - good + (long)sizeof(rec) - 1) / (long)sizeof(rec));
+            return -1;
+        }
+        if (size > good) {
+            fprintf(stderr,"%s: %ld records; %s a torn last record of %ld bytes\n",
+                path, nrec, read_only ? "ignoring" : "dropping", size - good);
+            if (!read_only && truncate(path,good) != 0) {
+                fprintf(stderr,"E: %s: truncate failed\n", path);
+                return -1;
+            }
+        }
+    } else if (read_only) {
+        fprintf(stderr,"E: %s: cannot open\n", path);
+        return -1;
+    }
+
+    if (read_only) {
+        return 0;
+    }
+    if ((sw->ckpt = fopen(path,"ab")) == 0) {
+        fprintf(stderr,"E: %s: cannot open\n", path);
+        return -1;
+    }
+    if (good == 0 && (fwrite(&hdr,sizeof(hdr),1,sw->ckpt) != 1 || fflush(sw->ckpt) != 0)) {
+        fprintf(stderr,"E: %s: write failed\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static const sweep_res_t * rank_res;
+
+static int rank_cmp(const void * a, const void * b)
+{
+    uint32_t i = *(const uint32_t *)a, j = *(const uint32_t *)b;
+    const sweep_res_t * x = &rank_res[i], * y = &rank_res[j];
+
+    if ((x->period != 0) != (y->period != 0)) return x->period != 0 ? 1 : -1;
+    if (x->period != y->period) return x->period < y->period ? 1 : -1; // longer first
+    if (x->pmin != y->pmin) return x->pmin < y->pmin ? 1 : -1;
+    if (x->fails != y->fails) return x->fails > y->fails ? 1 : -1;
+    return (i > j) - (i < j);
+}
+
+static int sweep_rank(const sweep_t * sw, unsigned top)
+{
+    uint32_t * idx, n = 0, c, i;
+    uint64_t cycled = 0, pass[SWEEP_NROT][SWEEP_NSHAPES], total[SWEEP_NROT][SWEEP_NSHAPES];
+    unsigned shape, shift, k;
+    uint16_t S;
+
+    if ((idx = (uint32_t *)malloc(sizeof(uint32_t) * SWEEP_NCONF)) == 0) {
+        fprintf(stderr,"E: out of memory\n");
+        return -1;
+    }
+    memset(pass,0,sizeof(pass));
+    memset(total,0,sizeof(total));
+    for (c = 0; c < SWEEP_NCONF; ++c) {
+        if (sw->done[c / SWEEP_UNIT]) {
+            const sweep_res_t * r = &sw->res[c];
+            sweep_conf(c,&shape,&shift,&S);
+            idx[n++] = c;
+            cycled += r->period != 0;
+            total[shift - SWEEP_ROT_MIN][shape] += 1;
+            pass[shift - SWEEP_ROT_MIN][shape] += r->fails == 0;
+        }
+    }
+    rank_res = sw->res;
+    qsort(idx,n,sizeof(idx[0]),rank_cmp);
+
+    printf("\n%u of %u configurations (%u of %u units), 2^%u steps each; %llu cycled within the budget\n",
+        n, SWEEP_NCONF, sw->ndone, SWEEP_NUNITS, sw->log2_steps, (unsigned long long)cycled);
+
+    printf("\nno failed test within min(budget, period): passed/done, per rotation and shape\nrot");
+    for (k = 0; k < SWEEP_NSHAPES; ++k) {
+        printf(" %15s", shape_names[k]);
+    }
+    printf("\n");
+    for (i = 0; i < SWEEP_NROT; ++i) {
+        printf("%3u", SWEEP_ROT_MIN + i);
+        for (k = 0; k < SWEEP_NSHAPES; ++k) {
+            printf(" %7llu/%-7llu", (unsigned long long)pass[i][k], (unsigned long long)total[i][k]);
+        }
+        printf("\n");
+    }
+
+    printf("\n%4s %5s %3s %6s %10s %5s %s\n", "rank", "shape", "rot", "S", "pmin", "fails", "period");
+    for (i = 0; i < n && i < top; ++i) {
+        const sweep_res_t * r = &sw->res[idx[i]];
+        sweep_conf(idx[i],&shape,&shift,&S);
+        printf("%4u %5s %3u 0x%04x %10.4g %5u ", i + 1, shape_names[shape], shift, S, r->pmin, r->fails);
+        if (r->period) {
+            printf("2^16 * %u\n", r->period);
+        } else {
+            printf("> 2^%u\n", sw->log2_steps);
+        }
+    }
+
+    free(idx);
+    return 0;
+}
+
+static double now_sec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+int main(int argc, char * argv[])
+{
+    static sweep_t sw;
+    static sweep_job_t jobs[MAX_THREADS];
+    pthread_t tid[MAX_THREADS];
+    const char * path = "weyl-sweep.ckpt";
+    unsigned nthreads = 0, top = 32, rank_only = 0, ndone0, t, finished;
+    double t0, el;
+    int opt;
+
+    sw.log2_steps = 20;
+    sw.max_units = SWEEP_NUNITS;
+
+    while ((opt = getopt(argc,argv,"n:f:t:u:k:R")) != -1) {
+        switch (opt) {
+        case 'n': sw.log2_steps = atoi(optarg); break;
+        case 'f': path = optarg; break;
+        case 't': nthreads = atoi(optarg); break;
+        case 'u': sw.max_units = atoi(optarg); break;
+        case 'k': top = atoi(optarg); break;
+        case 'R': rank_only = 1; break;
+        default:
+            fprintf(stderr,"usage: see header of weyl-sweep.c\n");
+            return 1;
+        }
+    }
+    if (sw.log2_steps < 16 || sw.log2_steps > 40) {
+        fprintf(stderr,"E: need 16 <= log2_steps <= 40\n");
+        return 1;
+    }
+    if (nthreads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = ncpu > 0 ? (unsigned)ncpu : 1;
+    }
+    if (nthreads > MAX_THREADS) {
+        nthreads = MAX_THREADS;
+    }
+
+    if ((sw.res = (sweep_res_t *)calloc(SWEEP_NCONF,sizeof(sweep_res_t))) == 0) {
+        fprintf(stderr,"E: out of memory\n");
+        return 1;
+    }
+    pthread_mutex_init(&sw.lock,0);
+    if (sweep_open(&sw,path,rank_only) != 0) {
+        return 1;
+    }
+    ndone0 = sw.ndone;
+
+    if (!rank_only && sw.ndone < SWEEP_NUNITS && sw.max_units > 0) {
+        fprintf(stderr,"%s: %u of %u units done, resuming with %u threads\n", path, sw.ndone, SWEEP_NUNITS, nthreads);
+
+        for (t = 0; t < nthreads; ++t) {
+            jobs[t].sw = &sw;
+            jobs[t].b = (battery_t *)malloc(sizeof(battery_t) * MSWS16_W);
+            jobs[t].buf = (uint32_t *)malloc(sizeof(uint32_t) * MSWS16_W*SWEEP_BATCH/4);
+            jobs[t].seen = (uint64_t *)malloc(sizeof(uint64_t) * MSWS16_W*SWEEP_SEEN);
+            if (jobs[t].b == 0 || jobs[t].buf == 0 || jobs[t].seen == 0) {
+                fprintf(stderr,"E: out of memory\n");
+                return 1;
+            }
+            if (pthread_create(&tid[t],0,sweep_worker,&jobs[t]) != 0) {
+                fprintf(stderr,"E: pthread_create() failed\n");
+                return 1;
+            }
+        }
+
+        // live progress on stderr, until every thread is done
+
+        t0 = now_sec();
+        do {
+            usleep(250000);
+            finished = __atomic_load_n(&sw.nexited,__ATOMIC_RELAXED) == nthreads;
+            pthread_mutex_lock(&sw.lock);
+            t = sw.ndone - ndone0;
+            el = now_sec() - t0;
+            fprintf(stderr,"\r%5.1f%%  %6.2f units/s  elapsed %6.0fs  ETA %8.0fs ",
+                100.0*sw.ndone/SWEEP_NUNITS, t/el, el, t ? el*(SWEEP_NUNITS - sw.ndone)/t : 0.0);
+            pthread_mutex_unlock(&sw.lock);
+        } while (!finished);
+        fprintf(stderr,"\n");
+
+        for (t = 0; t < nthreads; ++t) {
+            pthread_join(tid[t],0);
+            free(jobs[t].b);
+            free(jobs[t].buf);
+            free(jobs[t].seen);
+        }
+    }
+    if (sw.ckpt) {
+        fclose(sw.ckpt);
+    }
+
+    if (sweep_rank(&sw,top) != 0) {
+        return 1;
+    }
+    free(sw.res);
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+FILE: xxtea-bench.c
+DESCRIP: benchmark of xxtea() vs ayb_xxtea() across block sizes
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+================================================================================
+USAGE: xxtea-bench [max_n [reps]] > results.json
+BUILD: cc -O2 -pthread -o xxtea-bench xxtea-bench.c
+    Sweeps n = 2, 4, 8, ..., max_n (default 1M) words for xxtea() and
+    ayb_xxtea(), encrypt and decrypt. Each measurement is preceded by a
+    warm-up, and repeated reps (default 31) times. A repetition times a batch
+    of calls that processes at least ~1MB, so that the clock resolution is
+    negligible. Reports cycles/byte (TSC reference cycles on x86, else 0),
+    ns/call, and allocations/call, as the median and p99 over the repetitions,
+    as JSON on stdout.
+================================================================================
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // for __rdtsc()
+#define BENCH_RDTSC() __rdtsc()
+#else
+#define BENCH_RDTSC() 0
+#endif
+
+static unsigned long bench_nalloc;
+
+static void * bench_malloc(size_t size)
+{
+    __atomic_add_fetch(&bench_nalloc,1,__ATOMIC_RELAXED);
+    return malloc(size);
+}
+
+#define XXTEA_MALLOC(size) bench_malloc(size)
+#define XXTEA_FREE(ptr) free(ptr)
+#define XXTEA_NO_MAIN
+#include "xxtea.c"
+
+#define MAX_REPS 1001
+
+typedef struct { double ns, cpb, allocs; } sample_t;
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+static int cmp_double(const void * a, const void * b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// q = 0.5: median, q = 0.99: p99 (nearest rank)
+static double quantile(double * x, unsigned count, double q)
+{
+    unsigned i = (unsigned)(q*count + 0.5);
+
+    qsort(x,count,sizeof(x[0]),cmp_double);
+    if (i > 0) --i;
+    if (i >= count) i = count-1;
+    return x[i];
+}
+
+static void bench(xxtea_fn_t fn, const char * name, int decrypt, int n, unsigned reps,
+    const uint32_t key[4], uint32_t * buf, int first)
+{
+    static double ns[MAX_REPS], cpb[MAX_REPS], allocs[MAX_REPS];
+    const size_t nbytes = n*sizeof(uint32_t);
+    const unsigned ncalls = nbytes >= (1 << 20) ? 1 : (unsigned)((1 << 20) / nbytes);
+    unsigned r, c;
+    int m = decrypt ? -n : n;
+
+    for (c = 0; c < ncalls || c < 2; ++c) { // warm-up
+        fn(buf,m,key);
+    }
+
+    for (r = 0; r < reps; ++r) {
+        unsigned long a0 = bench_nalloc;
+        uint64_t c0 = BENCH_RDTSC();
+        double t0 = now_ns();
+        for (c = 0; c < ncalls; ++c) {
+            fn(buf,m,key);
+        }
+        double t1 = now_ns();
+        uint64_t c1 = BENCH_RDTSC();
+        ns[r] = (t1 - t0) / ncalls;
+        cpb[r] = (double)(c1 - c0) / ((double)ncalls * nbytes);
+        allocs[r] = (double)(bench_nalloc - a0) / ncalls;
+    }
+
+    printf("%s    {\"fn\": \"%s\", \"op\": \"%s\", \"n\": %d, \"bytes\": %lu, \"calls\": %u, \"reps\": %u,\n",
+        first ? "" : ",\n", name, decrypt ? "decrypt" : "encrypt", n, (unsigned long)nbytes, ncalls, reps);
+    printf("     \"ns_per_call\": {\"median\": %.1f, \"p99\": %.1f},\n",
+        quantile(ns,reps,0.5), quantile(ns,reps,0.99));
+    printf("     \"cycles_per_byte\": {\"median\": %.3f, \"p99\": %.3f},\n",
+        quantile(cpb,reps,0.5), quantile(cpb,reps,0.99));
+    printf("     \"allocs_per_call\": {\"median\": %.3f, \"p99\": %.3f}}",
+        quantile(allocs,reps,0.5), quantile(allocs,reps,0.99));
+    fflush(stdout);
+}
+
+int main(int argc, const char * argv[])
+{
+    const uint32_t key[4] = { 0xaabbccdd, 0x1eeff001, 0x22334455, 0x96677889 };
+    int max_n = argc > 1 ? atoi(argv[1]) : (1 << 20);
+    unsigned reps = argc > 2 ? (unsigned)atoi(argv[2]) : 31;
+    uint32_t * buf;
+    int n, i, first = 1;
+
+    if (max_n < 2 || reps < 1 || reps > MAX_REPS) {
+        fprintf(stderr,"usage: %s [max_n >= 2 [reps = 1..%d]]\n", argv[0], MAX_REPS);
+        return 1;
+    }
+
+    buf = (uint32_t *)malloc(max_n*sizeof(uint32_t));
+    if (buf == 0) {
+        PANIC("out of memory");
+    }
+    for (i = 0; i < max_n; ++i) {
+        buf[i] = i*DELTA;
+    }
+
+    printf("{\"bench\": \"xxtea\", \"tsc\": %d, \"results\": [\n", BENCH_RDTSC() != 0);
+    for (n = 2; n <= max_n; n *= 2) {
+        bench(xxtea,"xxtea",0,n,reps,key,buf,first); first = 0;
+        bench(xxtea,"xxtea",1,n,reps,key,buf,first);
+        bench(ayb_xxtea,"ayb_xxtea",0,n,reps,key,buf,first);
+        bench(ayb_xxtea,"ayb_xxtea",1,n,reps,key,buf,first);
+        if (n > max_n/2) break; // no overflow
+    }
+    printf("\n]}\n");
+
+    free(buf);
+    return 0;
+}
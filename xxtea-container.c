@@ -0,0 +1,539 @@
+/*
+FILE: xxtea-container.c
+DESCRIP: seekable chunked container format for random-access xxtea decryption
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+2026-10-18: 1.0.1: overflow-safe nchunks: a header with plain_size near 2^64 is rejected
+2026-10-18: 1.0.2: pack checks chunk_size before sizing the output; an invalid ayb key is an error, not an assert
+================================================================================
+USAGE:
+    xxtea-container                                       # self test
+    xxtea-container pack   KEY in out [chunk_size [ayb]]  # default: 4096 0
+    xxtea-container unpack KEY in out
+    xxtea-container read   KEY in offset length > out
+    where KEY is 32 hex digits, i.e. key[0..3] as 4 x 8 hex digits.
+BUILD: cc -O2 -pthread -o xxtea-container xxtea-container.c
+================================================================================
+FORMAT (version 1), all integers are little-endian:
+
+    header, 32 bytes:
+        0: magic        "XXTC"
+        4: version      u32 = 1
+        8: flags        u32: bit 0: 0 = xxtea(), 1 = ayb_xxtea()
+       12: chunk_size   u32: plaintext bytes per chunk, multiple of 4, >= 8
+       16: plain_size   u64: total plaintext bytes
+       24: nchunks      u64: ceil(plain_size / chunk_size)
+    chunk index, nchunks x 16 bytes:
+        0: offset       u64: file offset of the chunk ciphertext
+        8: length       u32: chunk ciphertext bytes
+       12: reserved     u32 = 0
+    chunks
+
+Chunk i holds plaintext bytes [i*chunk_size, (i+1)*chunk_size). The last
+chunk is zero padded to a multiple of 4 bytes, and to at least 8 bytes. Each
+chunk is one independent xxtea block (in native word order), so any chunk can
+be decrypted by itself. To make equal plaintext chunks encrypt differently,
+the chunk number is xor-ed into words 0-1 of the plaintext before encryption:
+w[0] ^= lo32(i), w[1] ^= hi32(i).
+================================================================================
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define XXTEA_NO_MAIN
+#include "xxtea.c"
+
+#define XXTC_MAGIC          "XXTC"
+#define XXTC_VERSION        1
+#define XXTC_HEADER_SIZE    32
+#define XXTC_ENTRY_SIZE     16
+#define XXTC_CHUNK_MAX      (1 << 24)
+
+INLINE uint32_t xxtc_get32(const unsigned char * p)
+{
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+INLINE uint64_t xxtc_get64(const unsigned char * p)
+{
+    return xxtc_get32(p) | (uint64_t)xxtc_get32(p+4) << 32;
+}
+
+INLINE void xxtc_put32(unsigned char * p, uint32_t x)
+{
+    p[0] = x; p[1] = x >> 8; p[2] = x >> 16; p[3] = x >> 24;
+}
+
+INLINE void xxtc_put64(unsigned char * p, uint64_t x)
+{
+    xxtc_put32(p,(uint32_t)x);
+    xxtc_put32(p+4,(uint32_t)(x >> 32));
+}
+
+// ceil(plain_size / chunk_size), which must not wrap for any plain_size of a header
+
+GCC_ATTRIB(const,nothrow)
+INLINE uint64_t xxtc_nchunks(uint64_t plain_size, uint32_t chunk_size)
+{
+    return plain_size / chunk_size + (plain_size % chunk_size != 0);
+}
+
+GCC_ATTRIB(const,nothrow)
+INLINE uint32_t xxtc_chunk_len(uint64_t plain_size, uint32_t chunk_size, uint64_t i)
+{
+    uint64_t len = plain_size - i*chunk_size;
+
+    if (len > chunk_size) len = chunk_size;
+    len = (len + 3) & ~(uint64_t)3;
+    return len < 8 ? 8 : (uint32_t)len;
+}
+
+GCC_ATTRIB(const,nothrow)
+static uint64_t xxtc_packed_size(uint64_t plain_size, uint32_t chunk_size)
+{
+    uint64_t nchunks = xxtc_nchunks(plain_size,chunk_size);
+
+    if (nchunks == 0) {
+        return XXTC_HEADER_SIZE;
+    }
+    return XXTC_HEADER_SIZE + nchunks*XXTC_ENTRY_SIZE
+        + (nchunks-1)*chunk_size + xxtc_chunk_len(plain_size,chunk_size,nchunks-1);
+}
+
+// ==== writer
+
+typedef struct {
+    unsigned char * out;
+    const unsigned char * in;
+    uint64_t plain_size, begin, end;
+    uint32_t chunk_size;
+    const xxtea_ctx_t * ctx;
+} xxtc_pack_job_t;
+
+GCC_ATTRIB(nonnull)
+static void * xxtc_pack_worker(void * arg)
+{
+    const xxtc_pack_job_t * job = (const xxtc_pack_job_t *)arg;
+    uint64_t i, off;
+    uint32_t len, w[2];
+
+    for (i = job->begin; i < job->end; ++i) {
+        unsigned char * entry = job->out + XXTC_HEADER_SIZE + i*XXTC_ENTRY_SIZE;
+        uint64_t plain_off = i*job->chunk_size;
+        uint64_t plain_len = job->plain_size - plain_off;
+        unsigned char * c;
+
+        if (plain_len > job->chunk_size) plain_len = job->chunk_size;
+        len = xxtc_chunk_len(job->plain_size,job->chunk_size,i);
+        off = xxtc_get64(entry);
+        c = job->out + off;
+
+        memcpy(c,job->in + plain_off,plain_len);
+        memset(c + plain_len,0,len - plain_len);
+
+        memcpy(w,c,8); // tweak
+        w[0] ^= (uint32_t)i;
+        w[1] ^= (uint32_t)(i >> 32);
+        memcpy(c,w,8);
+
+        xxtea_ctx_encrypt(job->ctx,(uint32_t *)c,len/4);
+    }
+
+    return 0;
+}
+
+// out must be xxtc_packed_size(plain_size,chunk_size) bytes
+
+GCC_ATTRIB(nonnull)
+static void xxtc_pack(void * out, const void * in, uint64_t plain_size, uint32_t chunk_size,
+    const uint32_t key[4], int ayb, unsigned nthreads)
+{
+    unsigned char * o = (unsigned char *)out;
+    xxtc_pack_job_t jobs[XXTEA_MAX_THREADS];
+    uint64_t nchunks = xxtc_nchunks(plain_size,chunk_size), i, off;
+    xxtea_ctx_t ctx;
+    unsigned t;
+
+    assert(chunk_size % 4 == 0 && chunk_size >= 8 && chunk_size <= XXTC_CHUNK_MAX);
+
+    xxtea_ctx_init(&ctx,key,ayb);
+
+    memcpy(o,XXTC_MAGIC,4);
+    xxtc_put32(o+4,XXTC_VERSION);
+    xxtc_put32(o+8,ayb ? 1 : 0);
+    xxtc_put32(o+12,chunk_size);
+    xxtc_put64(o+16,plain_size);
+    xxtc_put64(o+24,nchunks);
+
+    off = XXTC_HEADER_SIZE + nchunks*XXTC_ENTRY_SIZE;
+    for (i = 0; i < nchunks; ++i) {
+        unsigned char * entry = o + XXTC_HEADER_SIZE + i*XXTC_ENTRY_SIZE;
+        uint32_t len = xxtc_chunk_len(plain_size,chunk_size,i);
+        xxtc_put64(entry,off);
+        xxtc_put32(entry+8,len);
+        xxtc_put32(entry+12,0);
+        off += len;
+    }
+
+    nthreads = xxtea_nthreads(nthreads);
+    if (nthreads > nchunks) {
+        nthreads = nchunks ? (unsigned)nchunks : 1;
+    }
+    for (t = 0; t < nthreads; ++t) {
+        jobs[t].out = o;
+        jobs[t].in = (const unsigned char *)in;
+        jobs[t].plain_size = plain_size;
+        jobs[t].begin = nchunks * t / nthreads;
+        jobs[t].end = nchunks * (t+1) / nthreads;
+        jobs[t].chunk_size = chunk_size;
+        jobs[t].ctx = &ctx;
+    }
+    xxtea_run_jobs(xxtc_pack_worker,jobs,sizeof(jobs[0]),nthreads);
+}
+
+// ==== reader
+
+// A reader works directly on the container bytes, e.g. a memory-mapped file,
+// and decrypts only the chunks that cover a requested range. A reader owns one
+// chunk of scratch space, so it must not be shared between threads.
+
+typedef struct {
+    const unsigned char * base;
+    uint64_t size, plain_size, nchunks;
+    uint32_t chunk_size;
+    xxtea_ctx_t ctx;
+    uint32_t * scratch;
+} xxtc_reader_t;
+
+// ayb_xxtea() needs at least 2 key words != 0
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE int xxtc_ayb_key_ok(const uint32_t key[4])
+{
+    return (key[0] != 0) + (key[1] != 0) + (key[2] != 0) + (key[3] != 0) >= 2;
+}
+
+// returns 0, -1 if the container is malformed, or -2 if it is an ayb
+// container and the key is not a valid ayb key
+
+GCC_ATTRIB(nonnull)
+static int xxtc_open(xxtc_reader_t * r, const void * base, uint64_t size, const uint32_t key[4])
+{
+    const unsigned char * b = (const unsigned char *)base;
+    uint64_t i, off, len;
+    uint32_t flags;
+
+    memset(r,0,sizeof(*r));
+
+    if (size < XXTC_HEADER_SIZE || memcmp(b,XXTC_MAGIC,4) != 0 || xxtc_get32(b+4) != XXTC_VERSION) {
+        return -1;
+    }
+
+    flags = xxtc_get32(b+8);
+    r->chunk_size = xxtc_get32(b+12);
+    r->plain_size = xxtc_get64(b+16);
+    r->nchunks = xxtc_get64(b+24);
+
+    if ((flags & ~1u) != 0 || r->chunk_size % 4 != 0 || r->chunk_size < 8 || r->chunk_size > XXTC_CHUNK_MAX
+        || r->nchunks != xxtc_nchunks(r->plain_size,r->chunk_size)
+        || r->nchunks > (size - XXTC_HEADER_SIZE) / XXTC_ENTRY_SIZE) {
+        return -1;
+    }
+
+    for (i = 0; i < r->nchunks; ++i) {
+        const unsigned char * entry = b + XXTC_HEADER_SIZE + i*XXTC_ENTRY_SIZE;
+        off = xxtc_get64(entry);
+        len = xxtc_get32(entry+8);
+        if (len != xxtc_chunk_len(r->plain_size,r->chunk_size,i) || off > size || len > size - off || off % 4 != 0) {
+            return -1;
+        }
+    }
+
+    if ((flags & 1) && !xxtc_ayb_key_ok(key)) {
+        return -2;
+    }
+
+    r->scratch = (uint32_t *)XXTEA_MALLOC(r->chunk_size);
+    if (r->scratch == 0) {
+        PANIC("out of memory");
+    }
+
+    r->base = b;
+    r->size = size;
+    xxtea_ctx_init(&r->ctx,key,flags & 1);
+
+    return 0;
+}
+
+GCC_ATTRIB(nonnull)
+static void xxtc_close(xxtc_reader_t * r)
+{
+    XXTEA_FREE(r->scratch);
+    r->scratch = 0;
+}
+
+// decrypt chunk i into w, which has room for its padded length
+
+GCC_ATTRIB(nonnull)
+static void xxtc_decrypt_chunk(xxtc_reader_t * r, uint64_t i, uint32_t * w)
+{
+    const unsigned char * entry = r->base + XXTC_HEADER_SIZE + i*XXTC_ENTRY_SIZE;
+    uint32_t len;
+
+    assert(i < r->nchunks);
+    len = xxtc_get32(entry+8);
+    memcpy(w,r->base + xxtc_get64(entry),len);
+    xxtea_ctx_decrypt(&r->ctx,w,len/4);
+    w[0] ^= (uint32_t)i;
+    w[1] ^= (uint32_t)(i >> 32);
+}
+
+// Copy plaintext bytes [offset, offset+length) to dst. Returns the number of
+// bytes copied, which is less than length only at the end of the payload.
+
+GCC_ATTRIB(nonnull)
+static size_t xxtc_read(xxtc_reader_t * r, uint64_t offset, void * dst, size_t length)
+{
+    unsigned char * d = (unsigned char *)dst;
+    size_t done = 0;
+
+    if (offset >= r->plain_size) {
+        return 0;
+    }
+    if (length > r->plain_size - offset) {
+        length = r->plain_size - offset;
+    }
+
+    while (done < length) {
+        uint64_t i = (offset + done) / r->chunk_size;
+        uint32_t skip = (offset + done) % r->chunk_size;
+        size_t n = r->chunk_size - skip;
+
+        if (n > length - done) n = length - done;
+
+        xxtc_decrypt_chunk(r,i,r->scratch);
+        memcpy(d + done,(unsigned char *)r->scratch + skip,n);
+        done += n;
+    }
+
+    return done;
+}
+
+// ==== command line
+
+static int parse_key(const char * s, uint32_t key[4])
+{
+    unsigned i, j;
+
+    if (strlen(s) != 32) {
+        return -1;
+    }
+    for (i = 0; i < 4; ++i) {
+        key[i] = 0;
+        for (j = 0; j < 8; ++j) {
+            char c = s[8*i + j];
+            unsigned d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+            if (d > 15) return -1;
+            key[i] = (key[i] << 4) | d;
+        }
+    }
+    return 0;
+}
+
+static const unsigned char * map_file(const char * path, uint64_t * size)
+{
+    struct stat st;
+    void * p;
+    int fd = open(path,O_RDONLY);
+
+    if (fd < 0 || fstat(fd,&st) != 0) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    *size = st.st_size;
+    p = st.st_size ? mmap(0,st.st_size,PROT_READ,MAP_SHARED,fd,0) : (void *)"";
+    close(fd);
+    return p == MAP_FAILED ? 0 : (const unsigned char *)p;
+}
+
+static unsigned char * create_file(const char * path, uint64_t size)
+{
+    void * p;
+    int fd = open(path,O_RDWR|O_CREAT|O_TRUNC,0644);
+
+    if (fd < 0 || ftruncate(fd,size) != 0) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    p = mmap(0,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+    return p == MAP_FAILED ? 0 : (unsigned char *)p;
+}
+
+static double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+static int selftest()
+{
+    const uint32_t key[4] = { 0xaabbccdd, 0x1eeff001, 0x22334455, 0x96677889 };
+    const uint64_t plain_size = (64 << 20) + 13;
+    unsigned char * plain = (unsigned char *)malloc(plain_size);
+    unsigned char buf[3*4096+100];
+    rnd32_t rnd = { 0, 0, 0xb5ad4eceda1ce2a9ULL };
+    int ayb, bad = 0;
+    uint64_t i;
+
+    if (plain == 0) {
+        PANIC("out of memory");
+    }
+    for (i = 0; i < plain_size; ++i) {
+        plain[i] = (unsigned char)(i * 131 + (i >> 12));
+    }
+
+    for (ayb = 0; ayb <= 1; ++ayb) {
+        uint64_t size = xxtc_packed_size(plain_size,4096);
+        unsigned char * packed = (unsigned char *)malloc(size);
+        xxtc_reader_t r;
+        double t0, t1;
+        unsigned j;
+
+        if (packed == 0) {
+            PANIC("out of memory");
+        }
+        xxtc_pack(packed,plain,plain_size,4096,key,ayb,0);
+        if (xxtc_open(&r,packed,size,key) != 0) {
+            PANIC("xxtc_open");
+        }
+
+        for (j = 0; j < 1000; ++j) {
+            uint64_t off = ((uint64_t)rnd32(&rnd) << 8 | (rnd32(&rnd) & 0xff)) % (plain_size + 10);
+            size_t len = rnd32(&rnd) % sizeof(buf);
+            size_t n = xxtc_read(&r,off,buf,len);
+            size_t want = off >= plain_size ? 0 : plain_size - off < len ? plain_size - off : len;
+            bad += n != want || (n && memcmp(buf,plain + off,n) != 0);
+        }
+
+        t0 = now_ns();
+        for (j = 0; j < 1000; ++j) {
+            xxtc_read(&r,(uint64_t)j*60013 % (plain_size - 4096),buf,4096);
+        }
+        t1 = now_ns();
+
+        printf("xxtea-container-%s: %s: 4KB read: %.1f us\n", ayb ? "ayb" : "original",
+            bad == 0 ? "ok" : "FAILED", (t1 - t0) / 1000 / 1000);
+
+        xxtc_close(&r);
+        free(packed);
+    }
+
+    free(plain);
+
+    { // crafted header: (plain_size + chunk_size - 1) wraps to nchunks 0 = the stated count
+        unsigned char hdr[XXTC_HEADER_SIZE];
+        xxtc_reader_t r;
+        int ok;
+
+        memcpy(hdr,XXTC_MAGIC,4);
+        xxtc_put32(hdr+4,XXTC_VERSION);
+        xxtc_put32(hdr+8,0);
+        xxtc_put32(hdr+12,8);
+        xxtc_put64(hdr+16,UINT64_MAX);
+        xxtc_put64(hdr+24,0);
+        ok = xxtc_open(&r,hdr,sizeof(hdr),key) != 0;
+        if (!ok) xxtc_close(&r);
+        printf("xxtea-container-malformed: %s\n", ok ? "ok" : "FAILED");
+        bad += !ok;
+    }
+
+    return bad != 0;
+}
+
+int main(int argc, const char * argv[])
+{
+    uint32_t key[4];
+    const unsigned char * in;
+    uint64_t in_size;
+
+    if (argc == 1) {
+        return selftest();
+    }
+    if (argc < 4 || parse_key(argv[2],key) != 0 || (in = map_file(argv[3],&in_size)) == 0) {
+        fprintf(stderr,"usage: see header of xxtea-container.c\n");
+        return 1;
+    }
+
+    if (strcmp(argv[1],"pack") == 0 && argc >= 5) {
+        uint32_t chunk_size = argc > 5 ? (uint32_t)strtoul(argv[5],0,0) : 4096;
+        int ayb = argc > 6 ? atoi(argv[6]) : 0;
+        uint64_t size;
+        unsigned char * out;
+
+        if (chunk_size % 4 != 0 || chunk_size < 8 || chunk_size > XXTC_CHUNK_MAX) {
+            fprintf(stderr,"E: chunk_size must be a multiple of 4 in [8,%d]\n", XXTC_CHUNK_MAX);
+            return 1;
+        }
+        if (ayb && !xxtc_ayb_key_ok(key)) {
+            fprintf(stderr,"E: ayb needs a key with at least 2 non-zero words\n");
+            return 1;
+        }
+        size = xxtc_packed_size(in_size,chunk_size);
+        if ((out = create_file(argv[4],size)) == 0) {
+            perror(argv[4]);
+            return 1;
+        }
+        xxtc_pack(out,in,in_size,chunk_size,key,ayb,0);
+        munmap(out,size);
+        return 0;
+    }
+
+    xxtc_reader_t r;
+    int rc = xxtc_open(&r,in,in_size,key);
+    if (rc == -2) {
+        fprintf(stderr,"E: %s: an ayb container needs a key with at least 2 non-zero words\n", argv[3]);
+        return 1;
+    }
+    if (rc != 0) {
+        fprintf(stderr,"E: %s: not a valid container\n", argv[3]);
+        return 1;
+    }
+
+    if (strcmp(argv[1],"unpack") == 0 && argc == 5) {
+        unsigned char * out = create_file(argv[4],r.plain_size);
+        if (out == 0 && r.plain_size != 0) {
+            perror(argv[4]);
+            return 1;
+        }
+        xxtc_read(&r,0,out,r.plain_size);
+        if (out) munmap(out,r.plain_size);
+    } else if (strcmp(argv[1],"read") == 0 && argc == 6) {
+        uint64_t off = strtoull(argv[4],0,0);
+        size_t len = strtoull(argv[5],0,0);
+        unsigned char * buf = (unsigned char *)malloc(len ? len : 1);
+        if (buf == 0) {
+            PANIC("out of memory");
+        }
+        fwrite(buf,1,xxtc_read(&r,off,buf,len),stdout);
+        free(buf);
+    } else {
+        fprintf(stderr,"usage: see header of xxtea-container.c\n");
+        return 1;
+    }
+
+    xxtc_close(&r);
+    return 0;
+}
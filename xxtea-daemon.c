@@ -0,0 +1,1017 @@
+/*
+FILE: xxtea-daemon.c
+DESCRIP: local xxtea/ayb_xxtea encryption daemon: Unix socket, shared memory payloads, request batching
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+2026-10-18: 1.0.1: XXTD_MAP requires a memfd sealed against shrinking
+2026-10-18: 1.0.2: XXTD_STATS sizes its buffer in size_t, at most 64KB
+2026-10-18: 1.0.3: XXTD_STATS reports the uncacheable keystream requests of the ks_cache
+2026-10-18: 1.0.4: the quantiles of XXTD_STATS are at most the recorded max
+================================================================================
+USAGE:
+    xxtea-daemon                                # self test: serve + client + stats
+    xxtea-daemon serve  SOCKET [-w usec]        # until SIGINT/SIGTERM
+    xxtea-daemon client SOCKET [-c clients] [-r requests] [-n max_n] [-a pct]
+    xxtea-daemon stats  SOCKET
+    -w usec     after the first ready request, wait up to usec for more
+                requests to fill the batch, default 0
+    -c clients  client processes, default 4
+    -r requests encrypt + decrypt round trips per client, default 100000
+    -n max_n    max block length in words, default 64
+    -a pct      percent of ayb_xxtea() requests, default 25
+BUILD: cc -O2 -march=native -pthread -o xxtea-daemon xxtea-daemon.c
+================================================================================
+PROTOCOL: SOCK_SEQPACKET, one xxtd_req_t per message, one xxtd_resp_t per
+reply, in native byte order (the daemon is local only).
+
+    XXTD_MAP    the client passes a memfd (SCM_RIGHTS) of off bytes, which the
+                daemon maps shared. All payloads live in this buffer. The
+                memfd must be sealed with F_SEAL_SHRINK: a client that could
+                truncate it would crash the daemon with SIGBUS.
+    XXTD_CRYPT  encrypt (or decrypt: XXTD_F_DECRYPT) in place the n words at
+                byte offset off of the buffer with key, using xxtea() (or
+                ayb_xxtea(): XXTD_F_AYB). off must be a multiple of 4.
+    XXTD_STATS  write the statistics as text at offset off, at most n bytes.
+
+A reply echoes id. status is 0, or the length of the text for XXTD_STATS, or
+-1 for an invalid request. Replies to one client may come out of order.
+
+The daemon polls the listening socket and all clients, reads every ready
+request (up to XXTD_PER_CLIENT per client per round), and runs the whole round
+as one batch, sorted by (variant, key, n): short xxtea() blocks of the same key
+go through xxtea_records(), i.e. the multi-lane kernels at full width even when
+every client sends one block at a time. ayb_xxtea() uses a keystream cache,
+and the prepared key contexts are cached too. It keeps histograms of the batch
+size (queue depth) and of the request latency, from receipt to reply.
+================================================================================
+*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for memfd_create(), accept4()
+#endif
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define XXTEA_NO_MAIN
+#include "xxtea.c"
+
+#define XXTD_MAGIC          0x44545858 // "XXTD"
+#define XXTD_MAX_CLIENTS    256
+#define XXTD_MAX_BATCH      4096 // requests
+#define XXTD_PER_CLIENT     64   // requests per client per round
+#define XXTD_OUT_MAX        256  // queued replies per client
+#define XXTD_CTX_SLOTS      64
+#define XXTD_WINDOW         32   // client: outstanding requests
+
+enum { XXTD_MAP = 1, XXTD_CRYPT, XXTD_STATS };
+
+#define XXTD_F_DECRYPT      1
+#define XXTD_F_AYB          2
+
+typedef struct {
+    uint32_t magic, op, flags, n;
+    uint64_t id, off;
+    uint32_t key[4];
+} xxtd_req_t;
+
+typedef struct {
+    uint64_t id;
+    int64_t status;
+} xxtd_resp_t;
+
+// ==== histograms: bin b counts values in [2^(b-1), 2^b), bin 0 counts 0
+
+typedef struct {
+    uint64_t bin[65], count, sum, max;
+} xxtd_hist_t;
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE void xxtd_hist_add(xxtd_hist_t * h, uint64_t x)
+{
+    h->bin[x ? 64 - __builtin_clzll(x) : 0] += 1;
+    h->count += 1;
+    h->sum += x;
+    if (x > h->max) h->max = x;
+}
+
+// upper bound of the bin that holds quantile q, but at most the maximum
+GCC_ATTRIB(nonnull,nothrow)
+static uint64_t xxtd_hist_quantile(const xxtd_hist_t * h, double q)
+{
+    uint64_t c = 0, rank = (uint64_t)(q*h->count), ub;
+    unsigned b;
+
+    for (b = 0; b < 65; ++b) {
+        c += h->bin[b];
+        if (c > rank) {
+            ub = b == 0 ? 0 : b == 64 ? h->max : (UINT64_C(1) << b) - 1;
+            return ub < h->max ? ub : h->max;
+        }
+    }
+    return h->max;
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+static size_t xxtd_hist_print(char * buf, size_t size, const char * name, const char * unit, const xxtd_hist_t * h)
+{
+    size_t len;
+    unsigned b;
+
+    len = snprintf(buf,size,"%s: count=%llu mean=%.1f p50<=%llu p99<=%llu max=%llu %s\n", name,
+        (unsigned long long)h->count, h->count ? (double)h->sum / h->count : 0.0,
+        (unsigned long long)xxtd_hist_quantile(h,0.5), (unsigned long long)xxtd_hist_quantile(h,0.99),
+        (unsigned long long)h->max, unit);
+    for (b = 0; b < 65 && len < size; ++b) {
+        if (h->bin[b]) {
+            len += snprintf(buf + len,size - len,"    [%llu, %llu]: %llu\n",
+                (unsigned long long)(b == 0 ? 0 : UINT64_C(1) << (b-1)),
+                (unsigned long long)(b == 0 ? 0 : b == 64 ? UINT64_MAX : (UINT64_C(1) << b) - 1),
+                (unsigned long long)h->bin[b]);
+        }
+    }
+    return len < size ? len : size - 1; // snprintf() truncated
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+// ==== messages
+
+GCC_ATTRIB(nonnull(2))
+static ssize_t xxtd_send(int fd, const void * msg, size_t len, int pass_fd, int flags)
+{
+    struct msghdr mh;
+    struct iovec iov;
+    union { char buf[CMSG_SPACE(sizeof(int))]; struct cmsghdr align; } u;
+    struct cmsghdr * cmsg;
+
+    memset(&mh,0,sizeof(mh));
+    iov.iov_base = (void *)msg;
+    iov.iov_len = len;
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    if (pass_fd >= 0) {
+        memset(&u,0,sizeof(u));
+        mh.msg_control = u.buf;
+        mh.msg_controllen = sizeof(u.buf);
+        cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg),&pass_fd,sizeof(int));
+    }
+    return sendmsg(fd,&mh,flags | MSG_NOSIGNAL);
+}
+
+// *rfd: the passed fd, else -1
+
+GCC_ATTRIB(nonnull)
+static ssize_t xxtd_recv(int fd, void * msg, size_t len, int * rfd, int flags)
+{
+    struct msghdr mh;
+    struct iovec iov;
+    union { char buf[CMSG_SPACE(sizeof(int))]; struct cmsghdr align; } u;
+    struct cmsghdr * cmsg;
+    ssize_t rc;
+
+    memset(&mh,0,sizeof(mh));
+    iov.iov_base = msg;
+    iov.iov_len = len;
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = u.buf;
+    mh.msg_controllen = sizeof(u.buf);
+    *rfd = -1;
+
+    rc = recvmsg(fd,&mh,flags | MSG_CMSG_CLOEXEC);
+    if (rc > 0) {
+        for (cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh,cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                if (*rfd >= 0) close(*rfd);
+                memcpy(rfd,CMSG_DATA(cmsg),sizeof(int));
+            }
+        }
+    }
+    return rc;
+}
+
+GCC_ATTRIB(nonnull)
+static int xxtd_sockaddr(struct sockaddr_un * sa, const char * path)
+{
+    memset(sa,0,sizeof(*sa));
+    sa->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(sa->sun_path)) {
+        return -1;
+    }
+    strcpy(sa->sun_path,path);
+    return 0;
+}
+
+// ==== server
+
+// Replies are queued, and sent without blocking: a client may be blocked
+// sending requests while its receive queue is full (for SOCK_SEQPACKET the
+// queue is short: net.unix.max_dgram_qlen), so a blocking send here could
+// deadlock. A client is not read while its queue could overflow.
+
+typedef struct {
+    int fd, dead;
+    unsigned char * shm;
+    size_t shm_size;
+    unsigned owed, out_len;             // owed: requests in the batch
+    xxtd_resp_t out[XXTD_OUT_MAX];
+} xxtd_client_t;
+
+typedef struct {
+    xxtd_req_t req;
+    unsigned client;
+    uint64_t t_recv;
+    int64_t status;
+} xxtd_item_t;
+
+typedef struct {
+    int lfd;
+    unsigned wait_us;
+    xxtd_client_t clients[XXTD_MAX_CLIENTS];
+    unsigned nclients;
+    xxtd_item_t batch[XXTD_MAX_BATCH];
+    unsigned nbatch;
+    xxtea_ctx_t ctx[XXTD_CTX_SLOTS];        // direct mapped by key
+    int ctx_valid[XXTD_CTX_SLOTS];
+    ayb_ks_cache_t ks_cache;
+    uint32_t stage[XXTD_MAX_BATCH*XXTEA_REC_MAX_N];
+    size_t stage_off[XXTD_MAX_BATCH+1];
+    xxtd_hist_t depth, latency;
+    uint64_t nrequests, nerrors, nbatches;
+} xxtd_server_t;
+
+static volatile sig_atomic_t xxtd_stop;
+
+static void xxtd_on_signal(int sig)
+{
+    (void)sig;
+    xxtd_stop = 1;
+}
+
+GCC_ATTRIB(nonnull)
+static const xxtea_ctx_t * xxtd_ctx_get(xxtd_server_t * srv, const uint32_t key[4], int ayb)
+{
+    uint32_t h = (key[0] ^ key[1]*3 ^ key[2]*5 ^ key[3]*7 ^ ayb) * DELTA;
+    unsigned slot = h >> 26; // XXTD_CTX_SLOTS = 64
+    xxtea_ctx_t * ctx = &srv->ctx[slot];
+
+    // ctx->k[0] == key
+    if (!srv->ctx_valid[slot] || ctx->ayb != ayb || memcmp(ctx->k[0],key,sizeof(ctx->k[0])) != 0) {
+        xxtea_ctx_init(ctx,key,ayb);
+        srv->ctx_valid[slot] = 1;
+    }
+    return ctx;
+}
+
+GCC_ATTRIB(nonnull)
+static size_t xxtd_stats_text(const xxtd_server_t * srv, char * buf, size_t size)
+{
+    size_t len;
+
+    len = snprintf(buf,size,"requests=%llu errors=%llu batches=%llu clients=%u ks_cache: hits=%llu misses=%llu evictions=%llu uncacheable=%llu\n",
+        (unsigned long long)srv->nrequests, (unsigned long long)srv->nerrors, (unsigned long long)srv->nbatches,
+        srv->nclients, (unsigned long long)srv->ks_cache.hits, (unsigned long long)srv->ks_cache.misses,
+        (unsigned long long)srv->ks_cache.evictions, (unsigned long long)srv->ks_cache.uncacheable);
+    if (len < size) len += xxtd_hist_print(buf + len,size - len,"queue depth","requests/batch",&srv->depth);
+    if (len < size) len += xxtd_hist_print(buf + len,size - len,"latency","ns",&srv->latency);
+    return len < size ? len : size - 1; // snprintf() truncated
+}
+
+static int xxtd_item_cmp(const void * a_, const void * b_)
+{
+    const xxtd_item_t * a = (const xxtd_item_t *)a_, * b = (const xxtd_item_t *)b_;
+    int c;
+
+    if (a->req.flags != b->req.flags) return a->req.flags < b->req.flags ? -1 : 1;
+    if ((c = memcmp(a->req.key,b->req.key,sizeof(a->req.key))) != 0) return c;
+    return (a->req.n > b->req.n) - (a->req.n < b->req.n);
+}
+
+GCC_ATTRIB(nonnull)
+INLINE uint32_t * xxtd_payload(xxtd_server_t * srv, const xxtd_item_t * it)
+{
+    return (uint32_t *)(srv->clients[it->client].shm + it->req.off);
+}
+
+// run count items, which have the same flags and key
+
+GCC_ATTRIB(nonnull)
+static void xxtd_run(xxtd_server_t * srv, xxtd_item_t * items, unsigned count)
+{
+    const int decrypt = (items[0].req.flags & XXTD_F_DECRYPT) != 0;
+    const int ayb = (items[0].req.flags & XXTD_F_AYB) != 0;
+    unsigned i, k, nrec = 0;
+    int n;
+
+    if (ayb) {
+        for (i = 0; i < count; ++i) {
+            n = (int)items[i].req.n;
+            ayb_xxtea_cached(&srv->ks_cache,xxtd_payload(srv,&items[i]),decrypt ? -n : n,items[i].req.key);
+        }
+        return;
+    }
+
+    // short blocks: stage, and run through the lanes together
+    srv->stage_off[0] = 0;
+    for (i = 0; i < count && items[i].req.n <= XXTEA_REC_MAX_N; ++i) {
+        memcpy((unsigned char *)srv->stage + srv->stage_off[nrec],xxtd_payload(srv,&items[i]),4*items[i].req.n);
+        srv->stage_off[nrec+1] = srv->stage_off[nrec] + 4*items[i].req.n;
+        ++nrec;
+    }
+    if (nrec > 0) {
+        xxtea_records((unsigned char *)srv->stage,srv->stage_off,nrec,items[0].req.key,0,decrypt);
+        for (k = 0; k < nrec; ++k) {
+            memcpy(xxtd_payload(srv,&items[k]),(unsigned char *)srv->stage + srv->stage_off[k],4*items[k].req.n);
+        }
+    }
+
+    // long blocks: one at a time, with the prepared key
+    if (i < count) {
+        const xxtea_ctx_t * ctx = xxtd_ctx_get(srv,items[0].req.key,0);
+        for (; i < count; ++i) {
+            if (decrypt) {
+                xxtea_ctx_decrypt(ctx,xxtd_payload(srv,&items[i]),(int)items[i].req.n);
+            } else {
+                xxtea_ctx_encrypt(ctx,xxtd_payload(srv,&items[i]),(int)items[i].req.n);
+            }
+        }
+    }
+}
+
+GCC_ATTRIB(nonnull)
+static void xxtd_reply(xxtd_client_t * c, uint64_t id, int64_t status)
+{
+    if (c->out_len == XXTD_OUT_MAX) {
+        c->dead = 1; // i.e. cannot happen: see xxtd_read()
+        return;
+    }
+    c->out[c->out_len].id = id;
+    c->out[c->out_len].status = status;
+    c->out_len += 1;
+}
+
+GCC_ATTRIB(nonnull)
+static void xxtd_flush(xxtd_client_t * c)
+{
+    unsigned k;
+    ssize_t rc = 0;
+
+    for (k = 0; k < c->out_len && !c->dead; ++k) {
+        rc = xxtd_send(c->fd,&c->out[k],sizeof(c->out[k]),-1,MSG_DONTWAIT);
+        if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (rc != (ssize_t)sizeof(c->out[k])) {
+            c->dead = 1;
+        }
+    }
+    memmove(c->out,c->out + k,(c->out_len - k)*sizeof(c->out[0]));
+    c->out_len -= k;
+}
+
+GCC_ATTRIB(nonnull)
+static void xxtd_process(xxtd_server_t * srv)
+{
+    xxtd_item_t * items = srv->batch;
+    unsigned i, j, nvalid = 0;
+    uint64_t t;
+
+    if (srv->nbatch == 0) {
+        return;
+    }
+    srv->nbatches += 1;
+    xxtd_hist_add(&srv->depth,srv->nbatch);
+
+    // the valid requests first, sorted, so that equal (flags, key) are adjacent
+    for (i = 0; i < srv->nbatch; ++i) {
+        if (items[i].status == 0) {
+            xxtd_item_t tmp = items[nvalid];
+            items[nvalid++] = items[i];
+            items[i] = tmp;
+        }
+    }
+    qsort(items,nvalid,sizeof(items[0]),xxtd_item_cmp);
+
+    for (i = 0; i < nvalid; i = j) {
+        for (j = i+1; j < nvalid && items[j].req.flags == items[i].req.flags
+            && memcmp(items[j].req.key,items[i].req.key,sizeof(items[i].req.key)) == 0; ++j) {
+        }
+        xxtd_run(srv,&items[i],j - i);
+    }
+
+    for (i = 0; i < srv->nbatch; ++i) {
+        xxtd_client_t * c = &srv->clients[items[i].client];
+        if (c->dead) {
+            continue;
+        }
+        c->owed -= 1;
+        xxtd_reply(c,items[i].req.id,items[i].status);
+        t = now_ns();
+        xxtd_hist_add(&srv->latency,t - items[i].t_recv);
+    }
+    srv->nbatch = 0;
+}
+
+// validate a request; XXTD_MAP and XXTD_STATS are handled at once
+
+GCC_ATTRIB(nonnull)
+static void xxtd_request(xxtd_server_t * srv, unsigned ci, const xxtd_req_t * req, int rfd)
+{
+    xxtd_client_t * c = &srv->clients[ci];
+    xxtd_resp_t resp;
+    xxtd_item_t * it;
+
+    resp.id = req->id;
+    resp.status = -1;
+
+    if (req->magic == XXTD_MAGIC && req->op == XXTD_CRYPT) {
+        it = &srv->batch[srv->nbatch++];
+        it->req = *req;
+        it->client = ci;
+        it->t_recv = now_ns();
+        it->status = 0;
+        c->owed += 1;
+        srv->nrequests += 1;
+        if (c->shm == 0 || req->n < 2 || req->n > INT32_MAX/4 || req->off % 4 != 0
+            || req->off > c->shm_size || 4*(uint64_t)req->n > c->shm_size - req->off
+            || (req->flags & ~(XXTD_F_DECRYPT | XXTD_F_AYB)) != 0
+            || ((req->flags & XXTD_F_AYB) && (req->key[0] != 0) + (req->key[1] != 0)
+                + (req->key[2] != 0) + (req->key[3] != 0) < 2)) {
+            it->status = -1;
+            srv->nerrors += 1;
+        }
+        if (rfd >= 0) close(rfd);
+        return;
+    }
+
+    if (req->magic == XXTD_MAGIC && req->op == XXTD_MAP && rfd >= 0 && c->shm == 0 && req->off > 0) {
+        struct stat sb;
+        int seals = fcntl(rfd,F_GET_SEALS);
+        void * p = MAP_FAILED;
+
+        if (seals >= 0 && (seals & F_SEAL_SHRINK) && fstat(rfd,&sb) == 0 && (uint64_t)sb.st_size >= req->off) {
+            p = mmap(0,req->off,PROT_READ | PROT_WRITE,MAP_SHARED,rfd,0);
+        }
+        if (p != MAP_FAILED) {
+            c->shm = (unsigned char *)p;
+            c->shm_size = req->off;
+            resp.status = 0;
+        }
+    } else if (req->magic == XXTD_MAGIC && req->op == XXTD_STATS && c->shm != 0
+        && req->off <= c->shm_size && req->n <= c->shm_size - req->off) {
+        // in size_t: n + 1 must not wrap for n = 2^32-1; and the text is
+        // never larger than a few KB
+        size_t max = req->n < 65536 ? (size_t)req->n : 65536;
+        char * text = (char *)malloc(max + 1);
+        if (text == 0) {
+            PANIC("out of memory");
+        }
+        resp.status = xxtd_stats_text(srv,text,max + 1);
+        memcpy(c->shm + req->off,text,resp.status);
+        free(text);
+    } else {
+        srv->nerrors += 1;
+    }
+    if (rfd >= 0) close(rfd);
+    xxtd_reply(c,resp.id,resp.status);
+}
+
+// read the ready requests of client ci, at most XXTD_PER_CLIENT, and only as
+// many as its reply queue can take
+
+GCC_ATTRIB(nonnull)
+static void xxtd_read(xxtd_server_t * srv, unsigned ci)
+{
+    xxtd_client_t * c = &srv->clients[ci];
+    xxtd_req_t req;
+    unsigned k;
+    ssize_t rc;
+    int rfd;
+
+    for (k = 0; k < XXTD_PER_CLIENT && srv->nbatch < XXTD_MAX_BATCH && !c->dead
+        && c->out_len + c->owed < XXTD_OUT_MAX; ++k) {
+        rc = xxtd_recv(c->fd,&req,sizeof(req),&rfd,MSG_DONTWAIT);
+        if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            break;
+        }
+        if (rc != (ssize_t)sizeof(req)) {
+            if (rfd >= 0) close(rfd);
+            if (rc <= 0) {
+                c->dead = 1; // EOF or error
+                break;
+            }
+            memset(&req,0,sizeof(req)); // i.e. invalid
+        }
+        xxtd_request(srv,ci,&req,rfd);
+    }
+}
+
+// close the dead clients, after their last batch is done
+
+GCC_ATTRIB(nonnull)
+static void xxtd_reap(xxtd_server_t * srv)
+{
+    unsigned i;
+
+    for (i = 0; i < srv->nclients; ) {
+        xxtd_client_t * c = &srv->clients[i];
+        if (c->dead) {
+            if (c->shm) munmap(c->shm,c->shm_size);
+            close(c->fd);
+            *c = srv->clients[--srv->nclients];
+        } else {
+            ++i;
+        }
+    }
+}
+
+GCC_ATTRIB(nonnull)
+static int xxtd_serve(const char * path, unsigned wait_us)
+{
+    xxtd_server_t * srv;
+    struct sockaddr_un sa;
+    struct pollfd pfd[1 + XXTD_MAX_CLIENTS];
+    struct sigaction act;
+    unsigned i, pass;
+    int rc;
+    char text[4096];
+
+    srv = (xxtd_server_t *)calloc(1,sizeof(*srv));
+    if (srv == 0) {
+        PANIC("out of memory");
+    }
+    srv->wait_us = wait_us;
+    ayb_ks_cache_init(&srv->ks_cache,256,1 << 22);
+
+    if (xxtd_sockaddr(&sa,path) != 0) {
+        fprintf(stderr,"E: %s: socket path too long\n", path);
+        return 1;
+    }
+    srv->lfd = socket(AF_UNIX,SOCK_SEQPACKET | SOCK_CLOEXEC,0);
+    unlink(path);
+    if (srv->lfd < 0 || bind(srv->lfd,(struct sockaddr *)&sa,sizeof(sa)) != 0 || listen(srv->lfd,64) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    memset(&act,0,sizeof(act));
+    act.sa_handler = xxtd_on_signal;
+    sigaction(SIGINT,&act,0);
+    sigaction(SIGTERM,&act,0);
+
+    while (!xxtd_stop) {
+        pfd[0].fd = srv->lfd;
+        pfd[0].events = POLLIN;
+        for (i = 0; i < srv->nclients; ++i) {
+            xxtd_client_t * c = &srv->clients[i];
+            pfd[1+i].fd = c->fd;
+            pfd[1+i].events = (c->out_len + c->owed < XXTD_OUT_MAX ? POLLIN : 0) | (c->out_len ? POLLOUT : 0);
+        }
+
+        // block until something is ready; then, if asked, linger for wait_us
+        // to let the batch fill, and read again
+        for (pass = 0; pass < 2; ++pass) {
+            if (pass == 1) {
+                if (srv->wait_us == 0 || srv->nbatch == 0 || xxtd_stop) {
+                    break;
+                }
+                usleep(srv->wait_us);
+                for (i = 0; i <= srv->nclients; ++i) {
+                    pfd[i].revents = 0;
+                }
+            }
+            rc = poll(pfd,1 + srv->nclients,pass == 0 ? -1 : 0);
+            if (rc < 0 && errno != EINTR) {
+                perror("poll");
+                return 1;
+            }
+            if (rc <= 0) {
+                break;
+            }
+
+            if (pfd[0].revents & POLLIN) {
+                int fd = accept4(srv->lfd,0,0,SOCK_CLOEXEC);
+                if (fd >= 0 && srv->nclients < XXTD_MAX_CLIENTS) {
+                    xxtd_client_t * c = &srv->clients[srv->nclients];
+                    memset(c,0,sizeof(*c));
+                    c->fd = fd;
+                    pfd[1 + srv->nclients].fd = fd;
+                    pfd[1 + srv->nclients].events = POLLIN;
+                    pfd[1 + srv->nclients].revents = 0;
+                    ++srv->nclients;
+                } else if (fd >= 0) {
+                    close(fd);
+                }
+            }
+            for (i = 0; i < srv->nclients; ++i) {
+                if (pfd[1+i].revents & POLLOUT) {
+                    xxtd_flush(&srv->clients[i]);
+                }
+                if (pfd[1+i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                    xxtd_read(srv,i);
+                }
+            }
+        }
+
+        xxtd_process(srv);
+        for (i = 0; i < srv->nclients; ++i) {
+            xxtd_flush(&srv->clients[i]);
+        }
+        xxtd_reap(srv);
+    }
+
+    xxtd_stats_text(srv,text,sizeof(text));
+    printf("%s", text);
+    for (i = 0; i < srv->nclients; ++i) {
+        srv->clients[i].dead = 1;
+    }
+    xxtd_reap(srv);
+    close(srv->lfd);
+    unlink(path);
+    ayb_ks_cache_free(&srv->ks_cache);
+    free(srv);
+    return 0;
+}
+
+// ==== client
+
+GCC_ATTRIB(nonnull)
+static int xxtd_connect(const char * path, size_t shm_size, unsigned char ** shm)
+{
+    struct sockaddr_un sa;
+    xxtd_req_t req;
+    xxtd_resp_t resp;
+    int fd, mfd, rfd;
+
+    if (xxtd_sockaddr(&sa,path) != 0) {
+        return -1;
+    }
+    fd = socket(AF_UNIX,SOCK_SEQPACKET | SOCK_CLOEXEC,0);
+    if (fd < 0 || connect(fd,(struct sockaddr *)&sa,sizeof(sa)) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    mfd = memfd_create("xxtea-daemon",MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mfd < 0 || ftruncate(mfd,shm_size) != 0 || fcntl(mfd,F_ADD_SEALS,F_SEAL_SHRINK | F_SEAL_SEAL) != 0
+        || (*shm = (unsigned char *)mmap(0,shm_size,PROT_READ | PROT_WRITE,MAP_SHARED,mfd,0)) == MAP_FAILED) {
+        PANIC("memfd");
+    }
+
+    memset(&req,0,sizeof(req));
+    req.magic = XXTD_MAGIC;
+    req.op = XXTD_MAP;
+    req.off = shm_size;
+    if (xxtd_send(fd,&req,sizeof(req),mfd,0) != (ssize_t)sizeof(req)
+        || xxtd_recv(fd,&resp,sizeof(resp),&rfd,0) != (ssize_t)sizeof(resp) || resp.status != 0) {
+        PANIC("XXTD_MAP failed");
+    }
+    close(mfd);
+
+    return fd;
+}
+
+typedef struct {
+    int n, decrypt, ayb;
+    unsigned key;
+} xxtd_slot_t;
+
+GCC_ATTRIB(nonnull)
+static void xxtd_issue(int fd, const xxtd_slot_t * s, unsigned slot, unsigned max_n, const uint32_t keys[][4])
+{
+    xxtd_req_t req;
+
+    memset(&req,0,sizeof(req));
+    req.magic = XXTD_MAGIC;
+    req.op = XXTD_CRYPT;
+    req.flags = (s->decrypt ? XXTD_F_DECRYPT : 0) | (s->ayb ? XXTD_F_AYB : 0);
+    req.n = s->n;
+    req.id = slot;
+    req.off = (uint64_t)slot*max_n*4;
+    memcpy(req.key,keys[s->key],sizeof(req.key));
+    if (xxtd_send(fd,&req,sizeof(req),-1,0) != (ssize_t)sizeof(req)) {
+        PANIC("send failed");
+    }
+}
+
+// one client process: requests round trips with a window of XXTD_WINDOW
+// outstanding requests, and checks every result against xxtea()/ayb_xxtea()
+
+static int xxtd_client(const char * path, unsigned id, unsigned nreq, unsigned max_n, unsigned ayb_pct)
+{
+    static const uint32_t keys[4][4] = {
+        { 0xaabbccdd, 0x1eeff001, 0x22334455, 0x96677889 },
+        { 1, 2, 3, 4 }, { 0xdeadbeef, 0, 0xfeedface, 0 }, { 0x9e3779b9, 0x7f4a7c15, 5, 6 } };
+    const size_t shm_size = (size_t)XXTD_WINDOW*max_n*4;
+    unsigned char * shm;
+    uint32_t * plain, * expect;
+    xxtd_slot_t slots[XXTD_WINDOW];
+    rnd32_t r = { 0, 0, (0x9e3779b97f4a7c15ULL + 2*id) | 1 };
+    unsigned issued = 0, done = 0, bad = 0, outstanding = 0, slot, k;
+    xxtd_resp_t resp;
+    int fd, rfd;
+    uint64_t t0;
+
+    if ((fd = xxtd_connect(path,shm_size,&shm)) < 0) {
+        perror(path);
+        return 1;
+    }
+    plain = (uint32_t *)malloc(shm_size);
+    expect = (uint32_t *)malloc(shm_size);
+    if (plain == 0 || expect == 0) {
+        PANIC("out of memory");
+    }
+
+    t0 = now_ns();
+    for (slot = 0; slot < XXTD_WINDOW; ++slot) {
+        slots[slot].n = slot < nreq ? 0 : -1; // 0: new, -1: idle
+        if (slot < nreq) {
+            ++issued;
+            ++outstanding;
+        }
+    }
+    for (;;) {
+        // fill and send the new slots
+        for (slot = 0; slot < XXTD_WINDOW; ++slot) {
+            xxtd_slot_t * s = &slots[slot];
+            uint32_t * v = (uint32_t *)shm + slot*max_n;
+            if (s->n != 0) {
+                continue;
+            }
+            s->n = 2 + rnd32(&r) % (max_n - 1);
+            s->decrypt = 0;
+            s->ayb = rnd32(&r) % 100 < ayb_pct;
+            s->key = rnd32(&r) % 4;
+            for (k = 0; k < (unsigned)s->n; ++k) {
+                v[k] = plain[slot*max_n + k] = expect[slot*max_n + k] = rnd32(&r);
+            }
+            (s->ayb ? ayb_xxtea : xxtea)(&expect[slot*max_n],s->n,keys[s->key]);
+            xxtd_issue(fd,s,slot,max_n,keys);
+        }
+        if (outstanding == 0) {
+            break;
+        }
+
+        if (xxtd_recv(fd,&resp,sizeof(resp),&rfd,0) != (ssize_t)sizeof(resp)) {
+            PANIC("recv failed");
+        }
+        slot = (unsigned)resp.id;
+        if (slot >= XXTD_WINDOW || resp.status != 0) {
+            ++bad;
+            break;
+        }
+        xxtd_slot_t * s = &slots[slot];
+        uint32_t * v = (uint32_t *)shm + slot*max_n;
+        if (!s->decrypt) {
+            bad += memcmp(v,&expect[slot*max_n],4*s->n) != 0;
+            s->decrypt = 1;
+            xxtd_issue(fd,s,slot,max_n,keys);
+        } else {
+            bad += memcmp(v,&plain[slot*max_n],4*s->n) != 0;
+            ++done;
+            if (issued < nreq) {
+                ++issued;
+                s->n = 0;
+            } else {
+                --outstanding;
+                s->n = -1;
+            }
+        }
+    }
+
+    printf("client %u: %u round trips, %.0f requests/s: %s\n", id, done,
+        2.0*done / ((now_ns() - t0)*1e-9), bad == 0 && done == nreq ? "ok" : "FAILED");
+    close(fd);
+    free(plain);
+    free(expect);
+    return bad != 0 || done != nreq;
+}
+
+static int xxtd_clients(const char * path, unsigned nclients, unsigned nreq, unsigned max_n, unsigned ayb_pct)
+{
+    pid_t * pids = (pid_t *)calloc(nclients,sizeof(pid_t));
+    unsigned i, failed = 0;
+    int status;
+
+    if (pids == 0) {
+        PANIC("out of memory");
+    }
+    fflush(stdout);
+    for (i = 0; i < nclients; ++i) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            int rc = xxtd_client(path,i,nreq,max_n,ayb_pct);
+            fflush(stdout);
+            _exit(rc);
+        } else if (pids[i] < 0) {
+            perror("fork");
+            ++failed;
+        }
+    }
+    for (i = 0; i < nclients; ++i) {
+        if (pids[i] > 0) {
+            failed += waitpid(pids[i],&status,0) != pids[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        }
+    }
+    free(pids);
+    return failed != 0;
+}
+
+static int xxtd_stats(const char * path)
+{
+    const size_t size = 1 << 16;
+    unsigned char * shm;
+    xxtd_req_t req;
+    xxtd_resp_t resp;
+    int fd, rfd;
+
+    if ((fd = xxtd_connect(path,size,&shm)) < 0) {
+        perror(path);
+        return 1;
+    }
+    memset(&req,0,sizeof(req));
+    req.magic = XXTD_MAGIC;
+    req.op = XXTD_STATS;
+    req.n = size - 1;
+    if (xxtd_send(fd,&req,sizeof(req),-1,0) != (ssize_t)sizeof(req)
+        || xxtd_recv(fd,&resp,sizeof(resp),&rfd,0) != (ssize_t)sizeof(resp) || resp.status < 0) {
+        fprintf(stderr,"E: XXTD_STATS failed\n");
+        return 1;
+    }
+    fwrite(shm,1,resp.status,stdout);
+    close(fd);
+    munmap(shm,size);
+    return 0;
+}
+
+// a client that maps an unsealed memfd and then truncates it: the daemon must
+// refuse the XXTD_MAP, and so survive the XXTD_CRYPT that would touch the
+// missing pages. Returns 0 if both requests are refused.
+
+static int xxtd_truncating_client(const char * path)
+{
+    struct sockaddr_un sa;
+    xxtd_req_t req;
+    xxtd_resp_t resp;
+    int fd, mfd, rfd, refused = 0;
+
+    if (xxtd_sockaddr(&sa,path) != 0) {
+        return 1;
+    }
+    fd = socket(AF_UNIX,SOCK_SEQPACKET | SOCK_CLOEXEC,0);
+    mfd = memfd_create("xxtea-daemon-unsealed",MFD_CLOEXEC);
+    if (fd < 0 || connect(fd,(struct sockaddr *)&sa,sizeof(sa)) != 0 || mfd < 0 || ftruncate(mfd,4096) != 0) {
+        PANIC("truncating client");
+    }
+
+    memset(&req,0,sizeof(req));
+    req.magic = XXTD_MAGIC;
+    req.op = XXTD_MAP;
+    req.off = 4096;
+    if (xxtd_send(fd,&req,sizeof(req),mfd,0) != (ssize_t)sizeof(req)
+        || xxtd_recv(fd,&resp,sizeof(resp),&rfd,0) != (ssize_t)sizeof(resp)) {
+        PANIC("XXTD_MAP failed");
+    }
+    refused += resp.status == -1;
+    if (ftruncate(mfd,0) != 0) {
+        PANIC("ftruncate");
+    }
+
+    req.op = XXTD_CRYPT;
+    req.n = 2;
+    req.off = 0;
+    req.key[0] = 1;
+    if (xxtd_send(fd,&req,sizeof(req),-1,0) != (ssize_t)sizeof(req)
+        || xxtd_recv(fd,&resp,sizeof(resp),&rfd,0) != (ssize_t)sizeof(resp)) {
+        PANIC("XXTD_CRYPT failed"); // e.g. the daemon died
+    }
+    refused += resp.status == -1;
+
+    close(mfd);
+    close(fd);
+    return refused != 2;
+}
+
+// serve on a temporary socket in a child process, run the clients against it,
+// and print the statistics
+
+// the quantiles are the upper bounds of their bins, but never above the
+// maximum: 128 alone is in the bin [128, 255]. Returns 0 if so.
+
+static int xxtd_hist_check()
+{
+    xxtd_hist_t h;
+
+    memset(&h,0,sizeof(h));
+    xxtd_hist_add(&h,128);
+    xxtd_hist_add(&h,3);
+    return xxtd_hist_quantile(&h,0.99) != 128 || xxtd_hist_quantile(&h,0.0) != 3;
+}
+
+static int selftest()
+{
+    char path[64];
+    pid_t pid;
+    int rc, fd, tries;
+    unsigned char * shm;
+
+    snprintf(path,sizeof(path),"/tmp/xxtea-daemon.%d.sock", (int)getpid());
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        int null = open("/dev/null",O_WRONLY);
+        dup2(null,1);
+        _exit(xxtd_serve(path,0));
+    }
+    for (tries = 0; tries < 1000; ++tries) {
+        if ((fd = xxtd_connect(path,4096,&shm)) >= 0 || (errno != ENOENT && errno != ECONNREFUSED)) {
+            break;
+        }
+        usleep(1000);
+    }
+    if (fd < 0) {
+        perror(path);
+        kill(pid,SIGTERM);
+        return 1;
+    }
+    close(fd);
+    munmap(shm,4096);
+
+    rc = xxtd_hist_check();
+    rc |= xxtd_truncating_client(path);
+    rc |= xxtd_clients(path,4,20000,64,25);
+    rc |= xxtd_stats(path);
+    kill(pid,SIGTERM);
+    waitpid(pid,0,0);
+    printf("xxtea-daemon: %s\n", rc == 0 ? "ok" : "FAILED");
+    return rc;
+}
+
+int main(int argc, char * argv[])
+{
+    unsigned wait_us = 0, nclients = 4, nreq = 100000, max_n = 64, ayb_pct = 25;
+    const char * path;
+    int opt;
+
+    if (argc == 1) {
+        return selftest();
+    }
+    if (argc < 3) {
+        fprintf(stderr,"usage: see header of xxtea-daemon.c\n");
+        return 1;
+    }
+    path = argv[2];
+    optind = 3;
+    while ((opt = getopt(argc,argv,"w:c:r:n:a:")) != -1) {
+        switch (opt) {
+        case 'w': wait_us = atoi(optarg); break;
+        case 'c': nclients = atoi(optarg); break;
+        case 'r': nreq = atoi(optarg); break;
+        case 'n': max_n = atoi(optarg); break;
+        case 'a': ayb_pct = atoi(optarg); break;
+        default:
+            fprintf(stderr,"usage: see header of xxtea-daemon.c\n");
+            return 1;
+        }
+    }
+
+    if (strcmp(argv[1],"serve") == 0) {
+        return xxtd_serve(path,wait_us);
+    }
+    if (strcmp(argv[1],"client") == 0) {
+        if (max_n < 2 || max_n > (1 << 20) || nclients < 1) {
+            fprintf(stderr,"E: need 2 <= max_n <= 2^20, clients >= 1\n");
+            return 1;
+        }
+        return xxtd_clients(path,nclients,nreq,max_n,ayb_pct);
+    }
+    if (strcmp(argv[1],"stats") == 0) {
+        return xxtd_stats(path);
+    }
+    fprintf(stderr,"usage: see header of xxtea-daemon.c\n");
+    return 1;
+}
@@ -0,0 +1,288 @@
+/*
+FILE: xxtea-diff.c
+DESCRIP: reduced-round xxtea/ayb_xxtea differential experiment engine
+================================================================================
+DATE: 2026-10-18T00:00:00Z
+LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
+REVISION HISTORY:
+2026-10-18: 1.0.0: original
+2026-10-18: 1.0.1: at most one thread per batch of DIFF_W pairs: a small -N gave NaN
+================================================================================
+USAGE: xxtea-diff [-a] [-n words] [-r rounds] [-d word:mask] [-N log2_pairs]
+                  [-t threads] [-s seed]
+    -a          ayb_xxtea() instead of xxtea()
+    -n words    block length, default 2
+    -r rounds   number of (reduced) rounds, default 1
+    -d w:mask   input difference: xor mask for word w, may be repeated,
+                default 0:0x80000000
+    -N log2     number of plaintext pairs = 2^log2, default 24
+    -t threads  default: one per online cpu
+    -s seed     key and plaintext seed, default 1
+BUILD: cc -O3 -march=native -pthread -o xxtea-diff xxtea-diff.c -lm
+    Encrypts random plaintext pairs (P, P^delta) under one random key with
+    the given number of rounds, 8 pairs at a time in vector lanes, spread
+    across threads. For the output difference D = C ^ C' it accumulates the
+    flip count of every bit, and the histogram of the Hamming weight of D.
+    Reports, for each bit, its bias |Pr[flip] - 1/2| and z-score, and for the
+    Hamming weight a chi-square statistic vs. Binomial(32n, 1/2). With enough
+    rounds every bias is ~0 and |z| is < ~5 for all bits.
+================================================================================
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define XXTEA_NO_MAIN
+#include "xxtea.c"
+
+#ifndef __GNUC__
+#error "xxtea-diff.c requires gcc/clang vector extensions"
+#endif
+
+#define DIFF_W          8       // lanes
+#define DIFF_MAX_N      64      // words
+#define DIFF_FLUSH      (1 << 20) // batches before the 32-bit lane counters are flushed
+
+typedef uint32_t diff_v_t __attribute__((vector_size(4*DIFF_W)));
+
+typedef struct {
+    int ayb, n, rounds;
+    uint32_t delta[DIFF_MAX_N];
+    uint32_t key[4];
+    const uint32_t * ks;        // AYB: keystream of n*rounds values
+    uint64_t nbatches;          // per thread
+    uint64_t seed;
+} diff_cfg_t;
+
+typedef struct {
+    const diff_cfg_t * cfg;
+    unsigned id;
+    uint64_t flips[DIFF_MAX_N*32];
+    uint64_t hw[DIFF_MAX_N*32 + 1];
+} diff_job_t;
+
+// reduced-round encrypt of DIFF_W blocks in SoA layout: same as xxtea_x8() and
+// ayb_xxtea_x8(), but with a given number of rounds
+
+GCC_ATTRIB(nonnull(1,3),nothrow,always_inline)
+INLINE void diff_encrypt(diff_v_t * v, int n, const uint32_t key[4], unsigned rounds, const uint32_t * ks)
+{
+    diff_v_t y, z;
+    uint32_t sum = 0;
+    unsigned p, e, r_i = 0;
+
+    z = v[n-1];
+    do {
+        sum += DELTA;
+        e = (sum >> 2) & 3;
+        for (p=0; p<(unsigned)n-1; p++) {
+            y = v[p+1];
+            z = v[p] += (ks ? ks[r_i++] : 0) ^ MXV;
+        }
+        y = v[0];
+        z = v[n-1] += (ks ? ks[r_i++] : 0) ^ MXV;
+    } while (--rounds);
+}
+
+static void * diff_worker(void * arg)
+{
+    diff_job_t * job = (diff_job_t *)arg;
+    const diff_cfg_t * cfg = job->cfg;
+    const int n = cfg->n;
+    diff_v_t a[DIFF_MAX_N], b[DIFF_MAX_N], acc[DIFF_MAX_N*32];
+    rnd32_t r = { 0, 0, (cfg->seed * 0x9e3779b97f4a7c15ULL + 2*job->id) | 1 };
+    uint64_t i;
+    unsigned p, l, bit, flush = 0;
+
+    memset(acc,0,sizeof(acc));
+
+    for (i = 0; i < cfg->nbatches; ++i) {
+        for (p = 0; p < (unsigned)n; ++p) {
+            for (l = 0; l < DIFF_W; ++l) {
+                a[p][l] = rnd32(&r);
+            }
+            b[p] = a[p] ^ cfg->delta[p];
+        }
+
+        diff_encrypt(a,n,cfg->key,cfg->rounds,cfg->ks);
+        diff_encrypt(b,n,cfg->key,cfg->rounds,cfg->ks);
+
+        for (p = 0; p < (unsigned)n; ++p) {
+            diff_v_t d = a[p] ^ b[p];
+            for (bit = 0; bit < 32; ++bit) {
+                acc[32*p + bit] += (d >> bit) & 1;
+            }
+            a[p] = d;
+        }
+
+        for (l = 0; l < DIFF_W; ++l) {
+            unsigned w = 0;
+            for (p = 0; p < (unsigned)n; ++p) {
+                w += __builtin_popcount(a[p][l]);
+            }
+            job->hw[w] += 1;
+        }
+
+        if (++flush == DIFF_FLUSH || i+1 == cfg->nbatches) {
+            for (p = 0; p < 32*(unsigned)n; ++p) {
+                for (l = 0; l < DIFF_W; ++l) {
+                    job->flips[p] += acc[p][l];
+                }
+                acc[p] ^= acc[p];
+            }
+            flush = 0;
+        }
+    }
+
+    return 0;
+}
+
+// ln(C(m,k))
+static double log_choose(unsigned m, unsigned k)
+{
+    return lgamma(m + 1.0) - lgamma(k + 1.0) - lgamma(m - k + 1.0);
+}
+
+int main(int argc, char * argv[])
+{
+    static diff_job_t jobs[XXTEA_MAX_THREADS];
+    diff_cfg_t cfg;
+    uint32_t * ks = 0;
+    unsigned nthreads = 0, t, nd = 0, log2_pairs = 24, m, p, k, worst = 0;
+    uint64_t flips[DIFF_MAX_N*32], hw[DIFF_MAX_N*32 + 1], npairs;
+    double chi2 = 0, zmax = 0, t0, t1;
+    struct timespec ts;
+    int opt, dof = 0;
+
+    memset(&cfg,0,sizeof(cfg));
+    cfg.n = 2;
+    cfg.rounds = 1;
+    cfg.seed = 1;
+
+    while ((opt = getopt(argc,argv,"an:r:d:N:t:s:")) != -1) {
+        switch (opt) {
+        case 'a': cfg.ayb = 1; break;
+        case 'n': cfg.n = atoi(optarg); break;
+        case 'r': cfg.rounds = atoi(optarg); break;
+        case 'd': {
+            char * end;
+            unsigned w = strtoul(optarg,&end,0);
+            if (*end != ':' || w >= DIFF_MAX_N) {
+                fprintf(stderr,"E: -d word:mask\n");
+                return 1;
+            }
+            cfg.delta[w] ^= strtoul(end+1,0,0);
+            ++nd;
+            break;
+        }
+        case 'N': log2_pairs = atoi(optarg); break;
+        case 't': nthreads = atoi(optarg); break;
+        case 's': cfg.seed = strtoull(optarg,0,0); break;
+        default:
+            fprintf(stderr,"usage: see header of xxtea-diff.c\n");
+            return 1;
+        }
+    }
+    if (nd == 0) {
+        cfg.delta[0] = 0x80000000;
+    }
+    if (cfg.n < 2 || cfg.n > DIFF_MAX_N || cfg.rounds < 1 || log2_pairs < 3 || log2_pairs > 50) {
+        fprintf(stderr,"E: need 2 <= n <= %d, rounds >= 1, 3 <= log2_pairs <= 50\n", DIFF_MAX_N);
+        return 1;
+    }
+    for (p = cfg.n; p < DIFF_MAX_N; ++p) {
+        if (cfg.delta[p]) {
+            fprintf(stderr,"E: input difference beyond word %d\n", cfg.n-1);
+            return 1;
+        }
+    }
+
+    // random key (>= 2 words != 0 for AYB), and for AYB the shared keystream
+    {
+        rnd32_t r = { 0, 0, cfg.seed*2 + 1 };
+        do {
+            for (k = 0; k < 4; ++k) cfg.key[k] = rnd32(&r);
+        } while ((cfg.key[0] != 0) + (cfg.key[1] != 0) + (cfg.key[2] != 0) + (cfg.key[3] != 0) < 2);
+    }
+    if (cfg.ayb) {
+        rnd32_t r_ctx;
+        ks = (uint32_t *)malloc(sizeof(uint32_t) * cfg.n*cfg.rounds);
+        if (ks == 0) {
+            PANIC("out of memory");
+        }
+        ayb_rnd32_init(&r_ctx,cfg.key);
+        rnd32_fill(&r_ctx,ks,cfg.n*cfg.rounds);
+        cfg.ks = ks;
+    }
+
+    nthreads = xxtea_nthreads(nthreads);
+    npairs = (uint64_t)1 << log2_pairs;
+    if (nthreads > npairs / DIFF_W) {
+        nthreads = (unsigned)(npairs / DIFF_W); // >= 1 batch per thread, or the statistics are 0/0
+    }
+    cfg.nbatches = npairs / DIFF_W / nthreads;
+    npairs = cfg.nbatches * DIFF_W * nthreads;
+
+    for (t = 0; t < nthreads; ++t) {
+        jobs[t].cfg = &cfg;
+        jobs[t].id = t;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC,&ts); t0 = ts.tv_sec + ts.tv_nsec*1e-9;
+    xxtea_run_jobs(diff_worker,jobs,sizeof(jobs[0]),nthreads);
+    clock_gettime(CLOCK_MONOTONIC,&ts); t1 = ts.tv_sec + ts.tv_nsec*1e-9;
+
+    // merge the per-thread statistics
+
+    m = 32*cfg.n;
+    memset(flips,0,sizeof(flips));
+    memset(hw,0,sizeof(hw));
+    for (t = 0; t < nthreads; ++t) {
+        for (p = 0; p < m; ++p) flips[p] += jobs[t].flips[p];
+        for (p = 0; p <= m; ++p) hw[p] += jobs[t].hw[p];
+    }
+
+    printf("%s: n=%d, rounds=%d (full=%d), pairs=%llu, threads=%u, %.2f Mpairs/s\n",
+        cfg.ayb ? "ayb_xxtea" : "xxtea", cfg.n, cfg.rounds, cfg.ayb ? 12 + 128/cfg.n : 6 + 52/cfg.n,
+        (unsigned long long)npairs, nthreads, npairs / (t1 - t0) / 1e6);
+    printf("delta:");
+    for (p = 0; p < (unsigned)cfg.n; ++p) printf(" %08x", cfg.delta[p]);
+    printf("\n\nbit bias (word.bit: Pr[flip], z):\n");
+
+    for (p = 0; p < m; ++p) {
+        double pr = (double)flips[p] / npairs;
+        double z = (flips[p] - npairs/2.0) / sqrt(npairs/4.0);
+        if (fabs(z) > zmax) {
+            zmax = fabs(z);
+            worst = p;
+        }
+        printf("%2u.%02u: %.6f %+9.2f%s", p/32, p%32, pr, z, (p % 4) == 3 ? "\n" : "   ");
+    }
+
+    // chi-square of the Hamming weight histogram, pooling bins with expected < 5
+    {
+        double expected = 0, observed = 0;
+        for (p = 0; p <= m; ++p) {
+            expected += exp(log_choose(m,p) - m*log(2.0)) * npairs;
+            observed += hw[p];
+            if (expected >= 5 || p == m) {
+                chi2 += (observed - expected) * (observed - expected) / expected;
+                expected = observed = 0;
+                ++dof;
+            }
+        }
+        --dof;
+    }
+
+    printf("\nmax |z| = %.2f at bit %u.%02u (bias %.6f)\n", zmax, worst/32, worst%32,
+        fabs((double)flips[worst] / npairs - 0.5));
+    printf("hamming weight: chi2 = %.1f, dof = %d, (chi2-dof)/sqrt(2*dof) = %+.2f\n",
+        chi2, dof, dof > 0 ? (chi2 - dof) / sqrt(2.0*dof) : 0.0);
+
+    free(ks);
+    return 0;
+}
@@ -8,12 +8,37 @@ COPYRIGHT (c) 2017 Avraham Bernstein, Jerusalem ISRAEL. All rights reserved.
 LICENSE: Apache License, Version 2.0: https://opensource.org/licenses/Apache-2.0
 REVISION HISTORY:
 2017-11-26: 1.0.0: AB: original
+2026-10-18: 1.1.0: multi-threaded batch API: xxtea_batch()
+2026-10-18: 1.2.0: multi-lane SIMD kernels: xxtea_x{4,8,16}(), ayb_xxtea_x{4,8,16}()
+2026-10-18: 1.3.0: ayb_xxtea() decrypt: O(sqrt(n*rounds)) checkpointed reverse keystream
+2026-10-18: 1.4.0: LRU keystream cache: ayb_ks_cache_t, ayb_xxtea_cached()
+2026-10-18: 1.5.0: prepared key context: xxtea_ctx_t
+2026-10-18: 1.5.1: XXTEA_MALLOC/XXTEA_FREE hooks, XXTEA_NO_MAIN for xxtea-bench.c
+2026-10-18: 1.6.0: scatter-gather API: xxtea_ctx_iov_encrypt(), xxtea_ctx_iov_decrypt()
+2026-10-18: 1.7.0: specialized kernels for n = 2, 4, 8, 16: xxtea_fixed()
+2026-10-18: 1.8.0: parallel wide-message mode: xxtea_wide_encrypt(), xxtea_wide_decrypt()
+2026-10-18: 1.9.0: fused crc32c: xxtea_ctx_encrypt_crc(), xxtea_ctx_decrypt_crc()
+2026-10-18: 1.10.0: zero-allocation AYB decrypt: ayb_xxtea_ws(), xxtea_ctx_decrypt_ws()
+2026-10-18: 1.11.0: block cipher modes: CTR, CBC: xxtea_mode_init/update/final(), xxtea_ctr(), xxtea_cbc_decrypt()
+2026-10-18: 1.12.0: ragged record batch, bucketed by length: xxtea_records()
+2026-10-18: 1.13.0: bulk rnd32(): rnd32_fill(), rnd64_fill(), rnd32_fill_streams()
+2026-10-18: 1.13.1: ayb_ks_cache_get(): a racing miss reuses the winner's entry; uncacheable counter
+2026-10-18: 1.13.2: ayb_rks_seg_len(): no 32-bit wrap for count near UINT_MAX
+2026-10-18: 1.13.3: ayb_rks_size(), ayb_rks_init(): no wrap of the segment count; ayb_ks_count() asserts n*rounds fits
 ================================================================================
 */
 #include <stdint.h>
 #include <stdlib.h> // for abort()
 #include <assert.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <unistd.h> // for sysconf()
+#include <sys/uio.h> // for struct iovec
+#if defined(__SSE4_2__)
+#include <nmmintrin.h> // for _mm_crc32_u64()
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h> // for __crc32cd()
+#endif
 
 #ifndef __cplusplus
 #define INLINE static inline
@@ -25,9 +50,11 @@ REVISION HISTORY:
 #ifdef __GNUC__
 #define GCC_ATTRIB(...) __attribute__((__VA_ARGS__))
 #define memcpy __builtin_memcpy
+#define memcmp __builtin_memcmp
+#define memset __builtin_memset
 #else
 #define GCC_ATTRIB(...)
-#include <string.h> // for memcpy()
+#include <string.h> // for memcpy(), memcmp(), memset()
 #endif
 
 GCC_ATTRIB(nonnull,nothrow)
@@ -42,6 +69,12 @@ static void perr(const char * emsg, const char * fname, int lineno, const char *
     }
 }
 
+// allocator hooks, e.g. for counting allocations: see xxtea-bench.c
+#ifndef XXTEA_MALLOC
+#define XXTEA_MALLOC(size) malloc(size)
+#define XXTEA_FREE(ptr) free(ptr)
+#endif
+
 #define PERR(emsg) perr(emsg,__FILE__,__LINE__,__PRETTY_FUNCTION__,0)
 #define PANIC(emsg) perr(emsg,__FILE__,__LINE__,__PRETTY_FUNCTION__,1)
 
@@ -64,14 +97,199 @@ INLINE uint32_t rnd32(rnd32_t * ctx)
     return x;
 }
 
+// Bulk rnd32(): the state is held in registers and checked once per call.
+// rnd32_fill() is the same sequence as count calls of rnd32(); rnd64_fill()
+// is pairs of it, low word first, i.e. the same bytes as rnd32_fill() of
+// 2*count on a little-endian cpu. Each value depends on the last through the
+// 64-bit multiply, ~5 cycles, so rnd32_fill_streams() steps RND32_STREAMS
+// independent contexts side by side and interleaves them: buf[i] is the next
+// value of ctx[i % RND32_STREAMS]. That is a different sequence, e.g. for
+// simulations; the keystream of AYB uses rnd32_fill().
+
+#define RND32_STREAMS   4
+
+#define RND32_STEP(x,w,S) (x *= x, x += (w += S), x = (x >> 32) | (x << 32))
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+INLINE void rnd32_fill(rnd32_t * ctx, uint32_t * buf, size_t count)
+{
+    assert(ctx != 0 && (ctx->S & 1) == 1);
+
+    uint64_t x = ctx->x, w = ctx->w;
+    const uint64_t S = ctx->S;
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        buf[i] = (uint32_t)RND32_STEP(x,w,S);
+    }
+    ctx->x = x;
+    ctx->w = w;
+}
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+INLINE void rnd64_fill(rnd32_t * ctx, uint64_t * buf, size_t count)
+{
+    assert(ctx != 0 && (ctx->S & 1) == 1);
+
+    uint64_t x = ctx->x, w = ctx->w, lo;
+    const uint64_t S = ctx->S;
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        lo = (uint32_t)RND32_STEP(x,w,S);
+        buf[i] = lo | (uint64_t)(uint32_t)RND32_STEP(x,w,S) << 32;
+    }
+    ctx->x = x;
+    ctx->w = w;
+}
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+INLINE void rnd32_fill_streams(rnd32_t ctx[RND32_STREAMS], uint32_t * buf, size_t count)
+{
+    uint64_t x0 = ctx[0].x, x1 = ctx[1].x, x2 = ctx[2].x, x3 = ctx[3].x;
+    uint64_t w0 = ctx[0].w, w1 = ctx[1].w, w2 = ctx[2].w, w3 = ctx[3].w;
+    const uint64_t S0 = ctx[0].S, S1 = ctx[1].S, S2 = ctx[2].S, S3 = ctx[3].S;
+    size_t i;
+
+    assert((S0 & S1 & S2 & S3 & 1) == 1);
+
+    for (i = 0; i + RND32_STREAMS <= count; i += RND32_STREAMS) {
+        buf[i  ] = (uint32_t)RND32_STEP(x0,w0,S0);
+        buf[i+1] = (uint32_t)RND32_STEP(x1,w1,S1);
+        buf[i+2] = (uint32_t)RND32_STEP(x2,w2,S2);
+        buf[i+3] = (uint32_t)RND32_STEP(x3,w3,S3);
+    }
+    if (i < count) buf[i++] = (uint32_t)RND32_STEP(x0,w0,S0);
+    if (i < count) buf[i++] = (uint32_t)RND32_STEP(x1,w1,S1);
+    if (i < count) buf[i++] = (uint32_t)RND32_STEP(x2,w2,S2);
+
+    ctx[0].x = x0; ctx[1].x = x1; ctx[2].x = x2; ctx[3].x = x3;
+    ctx[0].w = w0; ctx[1].w = w1; ctx[2].w = w2; ctx[3].w = w3;
+}
+
 #define DELTA   (uint32_t)0x9e3779b9
 #define MX      (uint32_t)( ((z>>5^y<<2) + (y>>3^z<<4)) ^ ((sum^y) + (key[(p&3)^e] ^ z)) )
 
 GCC_ATTRIB(nonnull,nothrow)
+INLINE void ayb_rnd32_init(rnd32_t * r_ctx, const uint32_t key[4])
+{
+    // AYB: the keystream depends only upon the key
+
+    r_ctx->x = DELTA * UINT32_C(613); // where 613 is prime, and DELTA is uint32_t
+    r_ctx->w = 0;
+    r_ctx->S = ((uint64_t)(key[0]^key[1])) | ((uint64_t)(key[2]^key[3]) << 32);
+    if (r_ctx->S == 0) {
+        r_ctx->S = ((uint64_t)(key[0]^key[2])) | ((uint64_t)(key[1]^key[3]) << 32);
+        if (r_ctx->S == 0) {
+            r_ctx->S = DELTA;
+        }
+    }
+    if ((r_ctx->S & 1) == 0) {
+        ++r_ctx->S;
+    }
+}
+
+// ==== fixed block length kernels
+
+// Specialized kernels for n = 2, 4, 8, 16 words. xxtea_fixed() is always
+// inlined with constant n, decrypt and ayb, so rounds is a compile-time
+// constant, the inner loop is fully unrolled (i.e. p&3 is a constant), and the
+// block is held in registers. The AYB decrypt keystream, at most
+// XXTEA_FIXED_KS_MAX values, is kept on the stack instead of the heap.
+// xxtea(), ayb_xxtea() and xxtea_ctx_encrypt()/xxtea_ctx_decrypt() dispatch to
+// these automatically. Define XXTEA_NO_FIXED to disable the dispatch.
+
+#define XXTEA_FIXED_KS_MAX (16*(12 + 128/16))
+
+#ifdef __GNUC__
+#define XXTEA_UNROLL _Pragma("GCC unroll 16")
+#else
+#define XXTEA_UNROLL
+#endif
+
+GCC_ATTRIB(nonnull(1,4),nothrow,always_inline)
+INLINE void xxtea_fixed(uint32_t * v, const int n, const int decrypt, const uint32_t key[4],
+    const int ayb, const rnd32_t * r_init)
+{
+    uint32_t w[16], ks[XXTEA_FIXED_KS_MAX], y, z, sum;
+    unsigned p, e, rounds = ayb ? 12 + 128/n : 6 + 52/n, r_i = 0;
+    rnd32_t r_ctx;
+
+    #define XXTEA_FIXED_R(expr) (ayb ? (expr) : 0)
+
+    if (ayb) {
+        r_ctx = *r_init;
+    }
+    memcpy(w,v,n*sizeof(w[0]));
+
+    if (!decrypt) {
+        sum = 0;
+        z = w[n-1];
+        do {
+            sum += DELTA;
+            e = (sum >> 2) & 3;
+            XXTEA_UNROLL
+            for (p=0; p<(unsigned)n-1; p++) {
+                y = w[p+1];
+                z = w[p] += XXTEA_FIXED_R(rnd32(&r_ctx)) ^ MX;
+            }
+            y = w[0];
+            z = w[n-1] += XXTEA_FIXED_R(rnd32(&r_ctx)) ^ MX;
+        } while (--rounds);
+    } else {
+        if (ayb) {
+            r_i = n*rounds;
+            rnd32_fill(&r_ctx,ks,r_i);
+        }
+        sum = rounds*DELTA;
+        y = w[0];
+        do {
+            e = (sum >> 2) & 3;
+            XXTEA_UNROLL
+            for (p=n-1; p>0; p--) {
+                z = w[p-1];
+                y = w[p] -= XXTEA_FIXED_R(ks[--r_i]) ^ MX;
+            }
+            z = w[n-1];
+            y = w[0] -= XXTEA_FIXED_R(ks[--r_i]) ^ MX;
+            sum -= DELTA;
+        } while (--rounds);
+    }
+
+    memcpy(v,w,n*sizeof(w[0]));
+
+    #undef XXTEA_FIXED_R
+}
+
+// returns 0 if n is not one of the specialized lengths
+
+GCC_ATTRIB(nonnull(1,3),nothrow,always_inline)
+INLINE int xxtea_fixed_dispatch(uint32_t * v, int n, const uint32_t key[4], const int ayb, const rnd32_t * r_init)
+{
+#ifndef XXTEA_NO_FIXED
+    switch (n) {
+    case   2: xxtea_fixed(v, 2,0,key,ayb,r_init); return 1;
+    case  -2: xxtea_fixed(v, 2,1,key,ayb,r_init); return 1;
+    case   4: xxtea_fixed(v, 4,0,key,ayb,r_init); return 1;
+    case  -4: xxtea_fixed(v, 4,1,key,ayb,r_init); return 1;
+    case   8: xxtea_fixed(v, 8,0,key,ayb,r_init); return 1;
+    case  -8: xxtea_fixed(v, 8,1,key,ayb,r_init); return 1;
+    case  16: xxtea_fixed(v,16,0,key,ayb,r_init); return 1;
+    case -16: xxtea_fixed(v,16,1,key,ayb,r_init); return 1;
+    }
+#endif
+    return 0;
+}
+
+GCC_ATTRIB(nonnull,nothrow,unused)
 static void xxtea(uint32_t * v, int n, const uint32_t key[4]) {
     // ref: https://en.wikipedia.org/wiki/XXTEA
     // clarified version: btea()
 
+    if (xxtea_fixed_dispatch(v,n,key,0,0)) {
+        return;
+    }
+
     uint32_t y, z, sum;
     unsigned p, rounds, e;
 
@@ -107,7 +325,118 @@ static void xxtea(uint32_t * v, int n, const uint32_t key[4]) {
     }
 }
 
+// ==== reverse keystream
+
+// The AYB decrypt consumes the rnd32() keystream in reverse order. Rather than
+// store all n*rounds values, store a checkpoint of the generator state at the
+// start of every segment of seg_len values, and regenerate one segment at a
+// time as the reader walks backwards into it. With seg_len ~ sqrt(count) this
+// needs O(sqrt(n*rounds)) memory for ~2x the rnd32() calls, e.g. ~100KB
+// instead of ~48MB for a 1M-word block. Small keystreams, count <=
+// AYB_RKS_FLAT_MAX, use a single segment (i.e. a flat array) and cost no extra
+// rnd32() calls.
+
+#ifndef AYB_RKS_FLAT_MAX
+#define AYB_RKS_FLAT_MAX 4096 // values
+#endif
+
+// the AYB keystream length n*rounds, n > 1, which must fit in unsigned, i.e.
+// n <= ~357M words
+
+GCC_ATTRIB(const,nothrow)
+INLINE unsigned ayb_ks_count(unsigned n)
+{
+    uint64_t count = (uint64_t)n*(12 + 128/n);
+
+    assert(n > 1 && count <= UINT32_MAX);
+    return (unsigned)count;
+}
+
+typedef struct {
+    rnd32_t * ckpt;     // ckpt[k] = generator state at value k*seg_len
+    uint32_t * seg;     // values of the current segment k
+    unsigned seg_len, k, i;
+} ayb_rks_t;
+
+GCC_ATTRIB(const,nothrow)
+INLINE unsigned ayb_rks_seg_len(unsigned count)
+{
+    unsigned x, y;
+
+    if (count <= AYB_RKS_FLAT_MAX) {
+        return count ? count : 1;
+    }
+
+    // ceil(sqrt(count)): Newton in 32 bits from ceil(count/2), without the
+    // count + 1 that wraps, down to floor(sqrt(count)); the final square
+    // x*x can wrap, so it is compared in 64 bits
+    x = count;
+    y = x/2 + (x & 1);
+    while (y < x) {
+        x = y;
+        y = (x + count/x) / 2;
+    }
+    return (uint64_t)x*x < count ? x+1 : x;
+}
+
+// workspace size in bytes for a keystream of count values
+
+GCC_ATTRIB(const,nothrow)
+INLINE size_t ayb_rks_size(unsigned count)
+{
+    unsigned seg_len = ayb_rks_seg_len(count);
+    unsigned nseg = count/seg_len + (count%seg_len != 0);
+
+    return nseg*sizeof(rnd32_t) + seg_len*sizeof(uint32_t);
+}
+
+// ws must be at least ayb_rks_size(count) bytes, aligned for rnd32_t
+
+GCC_ATTRIB(nonnull,nothrow)
+static void ayb_rks_init(ayb_rks_t * rks, const rnd32_t * r_ctx, unsigned count, void * ws)
+{
+    rnd32_t r = *r_ctx;
+    unsigned seg_len = ayb_rks_seg_len(count);
+    unsigned nseg = count/seg_len + (count%seg_len != 0);
+    unsigned k;
+
+    assert(count > 0);
+
+    rks->ckpt = (rnd32_t *)ws;
+    rks->seg = (uint32_t *)(rks->ckpt + nseg);
+    rks->seg_len = seg_len;
+
+    // walk the keystream forwards, saving only the checkpoints...
+    for (k = 0; k < nseg-1; ++k) {
+        rks->ckpt[k] = r;
+        rnd32_fill(&r,rks->seg,seg_len); // discarded
+    }
+
+    // ... and keep the last segment, which is the first one to be read
+    rks->ckpt[k] = r;
+    rks->k = k;
+    rks->i = count - k*seg_len;
+    rnd32_fill(&r,rks->seg,rks->i);
+}
+
 GCC_ATTRIB(nonnull,nothrow)
+static uint32_t ayb_rks_refill(ayb_rks_t * rks)
+{
+    rnd32_t r;
+
+    assert(rks->k > 0);
+
+    r = rks->ckpt[--rks->k];
+    rnd32_fill(&r,rks->seg,rks->seg_len);
+    rks->i = rks->seg_len;
+
+    return rks->seg[--rks->i];
+}
+
+// next keystream value, in reverse order
+#define AYB_RKS_NEXT(rks) ((rks)->i ? (rks)->seg[--(rks)->i] : ayb_rks_refill(rks))
+
+GCC_ATTRIB(nonnull,nothrow,unused)
 static void ayb_xxtea(uint32_t * v, int n, const uint32_t key[4]) {
 
 // AYB: BEGIN
@@ -143,17 +472,10 @@ static void ayb_xxtea(uint32_t * v, int n, const uint32_t key[4]) {
     // initialize PRNG
 
     rnd32_t r_ctx;
-    r_ctx.x = DELTA * UINT32_C(613); // where 613 is prime, and DELTA is uint32_t
-    r_ctx.w = 0;
-    r_ctx.S = ((uint64_t)(key[0]^key[1])) | ((uint64_t)(key[2]^key[3]) << 32);
-    if (r_ctx.S == 0) {
-        r_ctx.S = ((uint64_t)(key[0]^key[2])) | ((uint64_t)(key[1]^key[3]) << 32);
-        if (r_ctx.S == 0) {
-            r_ctx.S = DELTA;
-        }
-    }
-    if ((r_ctx.S & 1) == 0) {
-        ++r_ctx.S;
+    ayb_rnd32_init(&r_ctx,key);
+
+    if (xxtea_fixed_dispatch(v,op == OP_DECRYPT ? -n : n,key,1,&r_ctx)) {
+        return;
     }
 
 // AYB: END
@@ -177,31 +499,17 @@ static void ayb_xxtea(uint32_t * v, int n, const uint32_t key[4]) {
 
 // AYB: BEGIN
 
-        // allocate and initialize array of random numbers because we will be
-        // using them in reverse order
+        // the random numbers are used in reverse order: see ayb_rks_t
 
-        const int r_num_ops = n*rounds;
-        int r_i = r_num_ops - 1;
+        const unsigned r_num_ops = ayb_ks_count(n);
+        ayb_rks_t rks;
+        void * r_ws = XXTEA_MALLOC(ayb_rks_size(r_num_ops));
 
-        #pragma pack(push)
-        #pragma pack(4)
-
-        struct Uint32 { uint32_t x; };
-
-        #ifndef __cplusplus
-            struct Uint32 * r_arr = malloc(sizeof(struct Uint32) * r_num_ops);
-        #else
-            Uint32 * r_arr = new Uint32[r_num_ops];
-        #endif
-
-        #pragma pack(pop)
-
-        if (r_arr == 0) {
+        if (r_ws == 0) {
             PANIC("out of memory");
         }
 
-        // !!! load the random numbers in reverse order !!!
-        for (; r_i >= 0; --r_i) r_arr[r_i].x = rnd32(&r_ctx);
+        ayb_rks_init(&rks,&r_ctx,r_num_ops,r_ws);
 
 // AYB: END
 
@@ -211,58 +519,2324 @@ static void ayb_xxtea(uint32_t * v, int n, const uint32_t key[4]) {
             e = (sum >> 2) & 3;
             for (p=n-1; p>0; p--) {
                 z = v[p-1];
-                y = v[p] -= r_arr[++r_i].x ^ MX; // AYB
+                y = v[p] -= AYB_RKS_NEXT(&rks) ^ MX; // AYB
             }
             z = v[n-1];
-            y = v[0] -= r_arr[++r_i].x ^ MX; // AYB
+            y = v[0] -= AYB_RKS_NEXT(&rks) ^ MX; // AYB
             sum -= DELTA;
         } while (--rounds);
 
 // AYB: BEGIN
-        #ifndef __cplusplus
-            free(r_arr);
-        #else
-            delete[] r_arr;
-        #endif
+        XXTEA_FREE(r_ws);
 // AYB: END
     }
 }
 
-int main(int argc, const char * argv[])
+// ==== prepared key context
+
+// xxtea_ctx_init() does the per-key work of xxtea()/ayb_xxtea() once: the key
+// checks, the AYB keystream seed, and the key word selection of MX. For each e
+// the 4 words key[(p&3)^e], p&3 = 0..3, are stored in order, and the inner
+// loops are unrolled by 4 so that each key word is a loop invariant.
+
+typedef struct {
+    uint32_t k[4][4];   // k[e][p&3] = key[(p&3)^e]
+    rnd32_t r_init;     // AYB: keystream seed
+    int ayb;            // 0: xxtea(), 1: ayb_xxtea()
+} xxtea_ctx_t;
+
+#define MXK(k)  (uint32_t)( ((z>>5^y<<2) + (y>>3^z<<4)) ^ ((sum^y) + ((k) ^ z)) )
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void xxtea_ctx_init(xxtea_ctx_t * ctx, const uint32_t key[4], int ayb)
 {
-    const uint32_t key[4] = { 0xaabbccdd, 0x1eeff001, 0x22334455, 0x96677889 };
+    unsigned e, p;
 
-    #define N8 32
-    #define N32 (N8/4)
-    const unsigned char plaintext[N8] = {
-        'a','b','c','d','e','f','g','h',
-        'i','j','k','l','m','n','o','p',
-        'q','r','s','t','u','v','w','x',
-        'y','z','0','1','2','3','4',0
-    };
+    if (ayb) {
+        assert( ((key[0] != 0) + (key[1] != 0) + (key[2] != 0) + (key[3] != 0)) >= 2 ); // at least 2 keys != 0
+        ayb_rnd32_init(&ctx->r_init,key);
+    } else {
+        memset(&ctx->r_init,0,sizeof(ctx->r_init));
+    }
+    for (e = 0; e < 4; ++e) {
+        for (p = 0; p < 4; ++p) {
+            ctx->k[e][p] = key[p^e];
+        }
+    }
+    ctx->ayb = ayb != 0;
+}
 
-    unsigned char buf[N8];
-    int i;
+// r_ws: AYB decrypt only: ayb_rks_size(ayb_ks_count(n)) bytes, or 0 to malloc
 
-    assert(N8 >= 32 && N8%4 == 0);
+GCC_ATTRIB(nonnull(1,2),nothrow,always_inline)
+INLINE void xxtea_ctx_crypt(const xxtea_ctx_t * ctx, uint32_t * v, int n, const int ayb, void * r_ws)
+{
+    uint32_t y, z, sum, k0, k1, k2, k3;
+    const uint32_t * k;
+    unsigned p, e, rounds;
+    rnd32_t r_ctx = ctx->r_init;
+    ayb_rks_t rks;
+    void * r_alloc = 0;
 
-    printf("xxtea-original:\n");
-    memcpy(buf,plaintext,N8);
-    xxtea((uint32_t *)buf,N32,key);
-    xxtea((uint32_t *)buf,-N32,key);
-    for (i = 0; i < N8; ++i) {
-        printf("%2d: %c\n",i,buf[i]);
+    #define XXTEA_CTX_R(expr) (ayb ? (expr) : 0)
+
+    if (n > 1) {
+        rounds = ayb ? 12 + 128/n : 6 + 52/n;
+        sum = 0;
+        z = v[n-1];
+        do {
+            sum += DELTA;
+            e = (sum >> 2) & 3;
+            k = ctx->k[e];
+            k0 = k[0]; k1 = k[1]; k2 = k[2]; k3 = k[3];
+            for (p=0; p+4<(unsigned)n; p+=4) {
+                y = v[p+1]; z = v[p  ] += XXTEA_CTX_R(rnd32(&r_ctx)) ^ MXK(k0);
+                y = v[p+2]; z = v[p+1] += XXTEA_CTX_R(rnd32(&r_ctx)) ^ MXK(k1);
+                y = v[p+3]; z = v[p+2] += XXTEA_CTX_R(rnd32(&r_ctx)) ^ MXK(k2);
+                y = v[p+4]; z = v[p+3] += XXTEA_CTX_R(rnd32(&r_ctx)) ^ MXK(k3);
+            }
+            for (; p<(unsigned)n-1; p++) {
+                y = v[p+1];
+                z = v[p] += XXTEA_CTX_R(rnd32(&r_ctx)) ^ MXK(k[p&3]);
+            }
+            y = v[0];
+            z = v[n-1] += XXTEA_CTX_R(rnd32(&r_ctx)) ^ MXK(k[p&3]);
+        } while (--rounds);
+    } else if (n < -1) {
+        n = -n;
+        rounds = ayb ? 12 + 128/n : 6 + 52/n;
+        if (ayb) {
+            if (r_ws == 0) {
+                r_ws = r_alloc = XXTEA_MALLOC(ayb_rks_size(ayb_ks_count(n)));
+                if (r_ws == 0) {
+                    PANIC("out of memory");
+                }
+            }
+            ayb_rks_init(&rks,&r_ctx,ayb_ks_count(n),r_ws);
+        }
+        sum = rounds*DELTA;
+        y = v[0];
+        do {
+            e = (sum >> 2) & 3;
+            k = ctx->k[e];
+            k0 = k[0]; k1 = k[1]; k2 = k[2]; k3 = k[3];
+            for (p=n-1; p>0 && (p&3) != 3; p--) {
+                z = v[p-1];
+                y = v[p] -= XXTEA_CTX_R(AYB_RKS_NEXT(&rks)) ^ MXK(k[p&3]);
+            }
+            for (; p>=4; p-=4) {
+                z = v[p-1]; y = v[p  ] -= XXTEA_CTX_R(AYB_RKS_NEXT(&rks)) ^ MXK(k3);
+                z = v[p-2]; y = v[p-1] -= XXTEA_CTX_R(AYB_RKS_NEXT(&rks)) ^ MXK(k2);
+                z = v[p-3]; y = v[p-2] -= XXTEA_CTX_R(AYB_RKS_NEXT(&rks)) ^ MXK(k1);
+                z = v[p-4]; y = v[p-3] -= XXTEA_CTX_R(AYB_RKS_NEXT(&rks)) ^ MXK(k0);
+            }
+            for (; p>0; p--) {
+                z = v[p-1];
+                y = v[p] -= XXTEA_CTX_R(AYB_RKS_NEXT(&rks)) ^ MXK(k[p&3]);
+            }
+            z = v[n-1];
+            y = v[0] -= XXTEA_CTX_R(AYB_RKS_NEXT(&rks)) ^ MXK(k0);
+            sum -= DELTA;
+        } while (--rounds);
+        XXTEA_FREE(r_alloc);
     }
-    printf("\n");
 
-    printf("xxtea-ayb:\n");
-    memcpy(buf,plaintext,N8);
-    ayb_xxtea((uint32_t *)buf,N32,key);
-    ayb_xxtea((uint32_t *)buf,-N32,key);
-    for (i = 0; i < N8; ++i) {
-        printf("%2d: %c\n",i,buf[i]);
+    #undef XXTEA_CTX_R
+}
+
+// same as xxtea()/ayb_xxtea() with n > 1, for the key of the context
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void xxtea_ctx_encrypt(const xxtea_ctx_t * ctx, uint32_t * v, int n)
+{
+    assert(n > 1);
+
+    // ctx->k[0] == key
+    if (ctx->ayb) {
+        if (!xxtea_fixed_dispatch(v,n,ctx->k[0],1,&ctx->r_init)) {
+            xxtea_ctx_crypt(ctx,v,n,1,0);
+        }
+    } else {
+        if (!xxtea_fixed_dispatch(v,n,ctx->k[0],0,0)) {
+            xxtea_ctx_crypt(ctx,v,n,0,0);
+        }
+    }
+}
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void xxtea_ctx_decrypt(const xxtea_ctx_t * ctx, uint32_t * v, int n)
+{
+    assert(n > 1);
+
+    // ctx->k[0] == key
+    if (ctx->ayb) {
+        if (!xxtea_fixed_dispatch(v,-n,ctx->k[0],1,&ctx->r_init)) {
+            xxtea_ctx_crypt(ctx,v,-n,1,0);
+        }
+    } else {
+        if (!xxtea_fixed_dispatch(v,-n,ctx->k[0],0,0)) {
+            xxtea_ctx_crypt(ctx,v,-n,0,0);
+        }
+    }
+}
+
+// Zero-allocation AYB decrypt: ayb_xxtea() and xxtea_ctx_decrypt() malloc the
+// reverse keystream workspace on every decrypt with n > 16. Instead, query the
+// size once, and pass a caller-owned workspace, e.g. from a per-thread arena.
+// The workspace must be aligned for uint64_t. Encrypt, and xxtea() in either
+// direction, need no workspace.
+
+// workspace size in bytes for an AYB decrypt of n words
+
+GCC_ATTRIB(const,nothrow,unused)
+static size_t ayb_xxtea_ws_size(int n)
+{
+    if (n < 0) { n = -n; }
+    assert(n > 1);
+    return ayb_rks_size(ayb_ks_count(n));
+}
+
+// same as xxtea_ctx_decrypt(), but never allocates. Returns 0, or -1 if
+// ws_size < ayb_xxtea_ws_size(n), in which case v is unchanged.
+
+GCC_ATTRIB(nonnull(1,2),nothrow,unused)
+static int xxtea_ctx_decrypt_ws(const xxtea_ctx_t * ctx, uint32_t * v, int n, void * ws, size_t ws_size)
+{
+    assert(n > 1);
+
+    if (ctx->ayb) {
+        if (!xxtea_fixed_dispatch(v,-n,ctx->k[0],1,&ctx->r_init)) {
+            if (ws == 0 || ws_size < ayb_xxtea_ws_size(n)) {
+                return -1;
+            }
+            assert(((uintptr_t)ws & (sizeof(uint64_t)-1)) == 0);
+            xxtea_ctx_crypt(ctx,v,-n,1,ws);
+        }
+    } else {
+        if (!xxtea_fixed_dispatch(v,-n,ctx->k[0],0,0)) {
+            xxtea_ctx_crypt(ctx,v,-n,0,0);
+        }
     }
-    printf("\n");
 
     return 0;
 }
+
+// same as ayb_xxtea(), but never allocates: see xxtea_ctx_decrypt_ws()
+
+GCC_ATTRIB(nonnull(1,3),nothrow,unused)
+static int ayb_xxtea_ws(uint32_t * v, int n, const uint32_t key[4], void * ws, size_t ws_size)
+{
+    xxtea_ctx_t ctx;
+
+    assert( ((key[0] != 0) + (key[1] != 0) + (key[2] != 0) + (key[3] != 0)) >= 2 ); // at least 2 keys != 0
+
+    xxtea_ctx_init(&ctx,key,1);
+    if (n > 1) {
+        xxtea_ctx_encrypt(&ctx,v,n);
+        return 0;
+    }
+    return xxtea_ctx_decrypt_ws(&ctx,v,-n,ws,ws_size);
+}
+
+// ==== scatter-gather (iovec) API
+
+// Encrypt/decrypt the concatenation of an iovec list as one logical block, in
+// place, without gathering it into a contiguous buffer. The total length must
+// be a multiple of 4 bytes, and at least 2 words. The segments may have any
+// length and alignment: a word that straddles segment boundaries is
+// assembled/scattered bytewise, all other words are accessed in place. Each
+// word is located via a cursor that moves forwards (encrypt) or backwards
+// (decrypt) one segment at a time, so a round costs O(n + iovcnt).
+
+typedef struct {
+    const struct iovec * iov;
+    int seg;            // current segment
+    size_t off;         // byte offset of the current segment in the block
+} xxtea_iov_cur_t;
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE void xxtea_iov_seek(xxtea_iov_cur_t * c, size_t o)
+{
+    while (o < c->off) {
+        c->off -= c->iov[--c->seg].iov_len;
+    }
+    while (o >= c->off + c->iov[c->seg].iov_len) {
+        c->off += c->iov[c->seg++].iov_len;
+    }
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE unsigned char * xxtea_iov_ptr(xxtea_iov_cur_t * c, unsigned p, int * straddle)
+{
+    size_t o = 4*(size_t)p;
+
+    xxtea_iov_seek(c,o);
+    *straddle = o + 4 > c->off + c->iov[c->seg].iov_len;
+
+    return (unsigned char *)c->iov[c->seg].iov_base + (o - c->off);
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE uint32_t xxtea_iov_get(xxtea_iov_cur_t * c, unsigned p)
+{
+    int straddle;
+    unsigned char * ptr = xxtea_iov_ptr(c,p,&straddle), b[4];
+    uint32_t x;
+    unsigned i;
+
+    if (!straddle) {
+        memcpy(&x,ptr,4);
+    } else {
+        xxtea_iov_cur_t t = *c;
+        for (i = 0; i < 4; ++i) {
+            xxtea_iov_seek(&t,4*(size_t)p + i);
+            b[i] = *((unsigned char *)t.iov[t.seg].iov_base + (4*(size_t)p + i - t.off));
+        }
+        memcpy(&x,b,4);
+    }
+
+    return x;
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE void xxtea_iov_put(xxtea_iov_cur_t * c, unsigned p, uint32_t x)
+{
+    int straddle;
+    unsigned char * ptr = xxtea_iov_ptr(c,p,&straddle), b[4];
+    unsigned i;
+
+    if (!straddle) {
+        memcpy(ptr,&x,4);
+    } else {
+        xxtea_iov_cur_t t = *c;
+        memcpy(b,&x,4);
+        for (i = 0; i < 4; ++i) {
+            xxtea_iov_seek(&t,4*(size_t)p + i);
+            *((unsigned char *)t.iov[t.seg].iov_base + (4*(size_t)p + i - t.off)) = b[i];
+        }
+    }
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+static void xxtea_ctx_iov(const xxtea_ctx_t * ctx, const struct iovec * iov, int iovcnt, int decrypt)
+{
+    xxtea_iov_cur_t c, c0, cn;
+    uint32_t y, z, sum, x;
+    const uint32_t * k;
+    unsigned n, p, e, rounds;
+    size_t nbytes = 0;
+    rnd32_t r_ctx = ctx->r_init;
+    ayb_rks_t rks;
+    void * r_ws = 0;
+    int i;
+
+    for (i = 0; i < iovcnt; ++i) {
+        nbytes += iov[i].iov_len;
+    }
+    assert( nbytes % 4 == 0 && nbytes >= 8 && nbytes/4 <= INT32_MAX );
+
+    n = nbytes / 4;
+    rounds = ctx->ayb ? 12 + 128/n : 6 + 52/n;
+
+    // c0: word 0, cn: word n-1, c: moves with p
+
+    c0.iov = iov; c0.seg = 0; c0.off = 0;
+    cn = c0;
+    xxtea_iov_seek(&cn,nbytes-4);
+
+    if (!decrypt) {
+        sum = 0;
+        z = xxtea_iov_get(&cn,n-1);
+        do {
+            sum += DELTA;
+            e = (sum >> 2) & 3;
+            k = ctx->k[e];
+            c = c0;
+            x = xxtea_iov_get(&c,0);
+            for (p=0; p<n-1; p++) {
+                y = xxtea_iov_get(&c,p+1);
+                z = x += (ctx->ayb ? rnd32(&r_ctx) : 0) ^ MXK(k[p&3]);
+                xxtea_iov_put(&c,p,z);
+                x = y;
+            }
+            y = xxtea_iov_get(&c0,0);
+            z = x += (ctx->ayb ? rnd32(&r_ctx) : 0) ^ MXK(k[p&3]);
+            xxtea_iov_put(&cn,n-1,z);
+        } while (--rounds);
+    } else {
+        if (ctx->ayb) {
+            r_ws = XXTEA_MALLOC(ayb_rks_size(ayb_ks_count(n)));
+            if (r_ws == 0) {
+                PANIC("out of memory");
+            }
+            ayb_rks_init(&rks,&r_ctx,ayb_ks_count(n),r_ws);
+        }
+        sum = rounds*DELTA;
+        y = xxtea_iov_get(&c0,0);
+        do {
+            e = (sum >> 2) & 3;
+            k = ctx->k[e];
+            c = cn;
+            x = xxtea_iov_get(&c,n-1);
+            for (p=n-1; p>0; p--) {
+                z = xxtea_iov_get(&c,p-1);
+                y = x -= (ctx->ayb ? AYB_RKS_NEXT(&rks) : 0) ^ MXK(k[p&3]);
+                xxtea_iov_put(&c,p,y);
+                x = z;
+            }
+            z = xxtea_iov_get(&cn,n-1);
+            y = x -= (ctx->ayb ? AYB_RKS_NEXT(&rks) : 0) ^ MXK(k[0]);
+            xxtea_iov_put(&c0,0,y);
+            sum -= DELTA;
+        } while (--rounds);
+        XXTEA_FREE(r_ws);
+    }
+}
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void xxtea_ctx_iov_encrypt(const xxtea_ctx_t * ctx, const struct iovec * iov, int iovcnt)
+{
+    xxtea_ctx_iov(ctx,iov,iovcnt,0);
+}
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void xxtea_ctx_iov_decrypt(const xxtea_ctx_t * ctx, const struct iovec * iov, int iovcnt)
+{
+    xxtea_ctx_iov(ctx,iov,iovcnt,1);
+}
+
+// ==== keystream cache
+
+// The AYB keystream depends only upon the key (via r_ctx.S) and upon n (via
+// rounds), never upon the data. ayb_ks_cache_t keeps the forward keystreams of
+// the most recently used (key, n) pairs, bounded by both the number of entries
+// and the total number of cached words, and evicts the least recently used
+// entry first. Encrypt reads a keystream forwards, decrypt backwards, so a
+// cached decrypt needs neither rnd32() nor malloc. The cache is thread-safe;
+// an entry that is evicted while in use is freed on its last release.
+
+typedef struct ayb_ks_entry {
+    uint32_t key[4];
+    int n;              // > 1
+    unsigned count;     // = n*rounds
+    unsigned refs;
+    int evicted;
+    struct ayb_ks_entry * prev, * next; // LRU list: most recent first
+    uint32_t ks[1];     // count values
+} ayb_ks_entry_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    ayb_ks_entry_t * head, * tail;
+    size_t max_entries, max_words, nentries, nwords;
+    uint64_t hits, misses, evictions;
+    uint64_t uncacheable;   // keystreams larger than the whole cache: neither a hit nor a miss
+} ayb_ks_cache_t;
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void ayb_ks_cache_init(ayb_ks_cache_t * cache, size_t max_entries, size_t max_words)
+{
+    memset(cache,0,sizeof(*cache));
+    pthread_mutex_init(&cache->lock,0);
+    cache->max_entries = max_entries;
+    cache->max_words = max_words;
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+static void ayb_ks_cache_unlink(ayb_ks_cache_t * cache, ayb_ks_entry_t * entry)
+{
+    if (entry->prev) entry->prev->next = entry->next; else cache->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev; else cache->tail = entry->prev;
+    entry->prev = entry->next = 0;
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+static void ayb_ks_cache_push(ayb_ks_cache_t * cache, ayb_ks_entry_t * entry)
+{
+    entry->prev = 0;
+    entry->next = cache->head;
+    if (cache->head) cache->head->prev = entry; else cache->tail = entry;
+    cache->head = entry;
+}
+
+// caller holds the lock
+
+GCC_ATTRIB(nonnull,nothrow)
+static void ayb_ks_cache_evict(ayb_ks_cache_t * cache, ayb_ks_entry_t * entry)
+{
+    ayb_ks_cache_unlink(cache,entry);
+    cache->nentries -= 1;
+    cache->nwords -= entry->count;
+    cache->evictions += 1;
+    if (entry->refs == 0) {
+        XXTEA_FREE(entry);
+    } else {
+        entry->evicted = 1;
+    }
+}
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void ayb_ks_cache_free(ayb_ks_cache_t * cache)
+{
+    while (cache->head) {
+        assert(cache->head->refs == 0);
+        ayb_ks_cache_evict(cache,cache->head);
+    }
+    pthread_mutex_destroy(&cache->lock);
+}
+
+// caller holds the lock: the entry for (key, n) with a new reference, moved to
+// the front, or 0
+
+GCC_ATTRIB(nonnull,nothrow)
+static ayb_ks_entry_t * ayb_ks_cache_find(ayb_ks_cache_t * cache, const uint32_t key[4], int n)
+{
+    ayb_ks_entry_t * entry;
+
+    for (entry = cache->head; entry; entry = entry->next) {
+        if (entry->n == n && memcmp(entry->key,key,sizeof(entry->key)) == 0) {
+            entry->refs += 1;
+            ayb_ks_cache_unlink(cache,entry);
+            ayb_ks_cache_push(cache,entry);
+            return entry;
+        }
+    }
+    return 0;
+}
+
+// Return the keystream for (key, n), n > 1, with a reference that the caller
+// must release with ayb_ks_cache_release(). Returns 0 if the keystream is
+// larger than the whole cache.
+
+GCC_ATTRIB(nonnull,nothrow)
+static ayb_ks_entry_t * ayb_ks_cache_get(ayb_ks_cache_t * cache, const uint32_t key[4], int n)
+{
+    ayb_ks_entry_t * entry, * winner;
+    unsigned count = ayb_ks_count(n);
+    rnd32_t r_ctx;
+
+    assert(n > 1);
+
+    pthread_mutex_lock(&cache->lock);
+    entry = ayb_ks_cache_find(cache,key,n);
+    if (entry) {
+        cache->hits += 1;
+    } else if (count > cache->max_words || cache->max_entries == 0) {
+        cache->uncacheable += 1;
+    } else {
+        cache->misses += 1;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (entry || count > cache->max_words || cache->max_entries == 0) {
+        return entry;
+    }
+
+    // miss: generate outside of the lock
+
+    entry = (ayb_ks_entry_t *)XXTEA_MALLOC(sizeof(*entry) + (count-1)*sizeof(uint32_t));
+    if (entry == 0) {
+        PANIC("out of memory");
+    }
+    memcpy(entry->key,key,sizeof(entry->key));
+    entry->n = n;
+    entry->count = count;
+    entry->refs = 1;
+    entry->evicted = 0;
+    ayb_rnd32_init(&r_ctx,key);
+    rnd32_fill(&r_ctx,entry->ks,count);
+
+    // another thread may have inserted the same keystream meanwhile: use
+    // that one, so that a key is never cached twice
+
+    pthread_mutex_lock(&cache->lock);
+    if ((winner = ayb_ks_cache_find(cache,key,n)) != 0) {
+        pthread_mutex_unlock(&cache->lock);
+        XXTEA_FREE(entry);
+        return winner;
+    }
+    while (cache->tail && (cache->nentries + 1 > cache->max_entries || cache->nwords + count > cache->max_words)) {
+        ayb_ks_cache_evict(cache,cache->tail);
+    }
+    ayb_ks_cache_push(cache,entry);
+    cache->nentries += 1;
+    cache->nwords += count;
+    pthread_mutex_unlock(&cache->lock);
+
+    return entry;
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+static void ayb_ks_cache_release(ayb_ks_cache_t * cache, ayb_ks_entry_t * entry)
+{
+    int do_free;
+
+    pthread_mutex_lock(&cache->lock);
+    do_free = --entry->refs == 0 && entry->evicted;
+    pthread_mutex_unlock(&cache->lock);
+
+    if (do_free) {
+        XXTEA_FREE(entry);
+    }
+}
+
+// same as ayb_xxtea(), but with a precomputed keystream of n*rounds values
+
+GCC_ATTRIB(nonnull,nothrow)
+static void ayb_xxtea_ks(uint32_t * v, int n, const uint32_t key[4], const uint32_t * ks)
+{
+    uint32_t y, z, sum;
+    unsigned p, e, rounds, r_i = 0;
+
+    if (n > 1) {
+        rounds = 12 + 128/n;
+        sum = 0;
+        z = v[n-1];
+        do {
+            sum += DELTA;
+            e = (sum >> 2) & 3;
+            for (p=0; p<(unsigned)n-1; p++) {
+                y = v[p+1];
+                z = v[p] += ks[r_i++] ^ MX;
+            }
+            y = v[0];
+            z = v[n-1] += ks[r_i++] ^ MX;
+        } while (--rounds);
+    } else if (n < -1) {
+        n = -n;
+        rounds = 12 + 128/n;
+        r_i = n*rounds;
+        sum = rounds*DELTA;
+        y = v[0];
+        do {
+            e = (sum >> 2) & 3;
+            for (p=n-1; p>0; p--) {
+                z = v[p-1];
+                y = v[p] -= ks[--r_i] ^ MX;
+            }
+            z = v[n-1];
+            y = v[0] -= ks[--r_i] ^ MX;
+            sum -= DELTA;
+        } while (--rounds);
+    }
+}
+
+// same as ayb_xxtea(), but looks up the keystream in the cache first
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void ayb_xxtea_cached(ayb_ks_cache_t * cache, uint32_t * v, int n, const uint32_t key[4])
+{
+    ayb_ks_entry_t * entry = ayb_ks_cache_get(cache,key,n < 0 ? -n : n);
+
+    if (entry == 0) {
+        ayb_xxtea(v,n,key);
+        return;
+    }
+
+    ayb_xxtea_ks(v,n,key,entry->ks);
+    ayb_ks_cache_release(cache,entry);
+}
+
+// ==== batch API
+
+// Encrypt/decrypt many independent blocks with a pool of worker threads.
+// Each descriptor follows the xxtea() calling convention: n > 1 encrypts, and
+// n < -1 decrypts. The work is split into contiguous descriptor ranges that
+// have (approximately) the same total word count, not the same number of
+// descriptors, because the cost of a block is proportional to its length.
+
+typedef void (*xxtea_fn_t)(uint32_t * v, int n, const uint32_t key[4]);
+
+typedef struct { uint32_t * v; int n; } xxtea_desc_t;
+
+#define XXTEA_MAX_THREADS 64
+
+typedef struct {
+    const xxtea_desc_t * descs;
+    size_t begin, end;
+    const uint32_t * key;
+    xxtea_fn_t fn;
+} xxtea_batch_job_t;
+
+GCC_ATTRIB(nonnull)
+static void * xxtea_batch_worker(void * arg)
+{
+    const xxtea_batch_job_t * job = (const xxtea_batch_job_t *)arg;
+    size_t i;
+
+    for (i = job->begin; i < job->end; ++i) {
+        job->fn(job->descs[i].v, job->descs[i].n, job->key);
+    }
+
+    return 0;
+}
+
+GCC_ATTRIB(nothrow)
+static unsigned xxtea_nthreads(unsigned nthreads)
+{
+    // 0 ==> one thread per online cpu
+
+    if (nthreads == 0) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = ncpu > 0 ? (unsigned)ncpu : 1;
+    }
+    if (nthreads > XXTEA_MAX_THREADS) {
+        nthreads = XXTEA_MAX_THREADS;
+    }
+
+    return nthreads;
+}
+
+// Run fn(jobs[0..njobs-1]): the last job runs on the calling thread. If a
+// thread cannot be created then its job also runs on the calling thread.
+// weyl-cycles.c has a copy, run_jobs().
+
+GCC_ATTRIB(nonnull)
+static void xxtea_run_jobs(void * (*fn)(void *), void * jobs, size_t job_size, unsigned njobs)
+{
+    pthread_t tid[XXTEA_MAX_THREADS];
+    int started[XXTEA_MAX_THREADS];
+    unsigned t;
+
+    assert(njobs <= XXTEA_MAX_THREADS);
+
+    for (t = 0; t + 1 < njobs; ++t) {
+        started[t] = pthread_create(&tid[t], 0, fn, (char *)jobs + t*job_size) == 0;
+    }
+    if (njobs > 0) {
+        fn((char *)jobs + (njobs-1)*job_size);
+    }
+    for (t = 0; t + 1 < njobs; ++t) {
+        if (started[t]) {
+            pthread_join(tid[t], 0);
+        } else {
+            fn((char *)jobs + t*job_size);
+        }
+    }
+}
+
+GCC_ATTRIB(nonnull,unused)
+static void xxtea_batch(xxtea_fn_t fn, const xxtea_desc_t * descs, size_t count,
+    const uint32_t key[4], unsigned nthreads)
+{
+    xxtea_batch_job_t jobs[XXTEA_MAX_THREADS];
+    uint64_t total = 0, acc = 0, target;
+    size_t i;
+    unsigned t, njobs;
+
+    for (i = 0; i < count; ++i) {
+        total += descs[i].n < 0 ? -(int64_t)descs[i].n : descs[i].n;
+    }
+
+    nthreads = xxtea_nthreads(nthreads);
+    if (nthreads > count) {
+        nthreads = count ? (unsigned)count : 1;
+    }
+
+    // cut the descriptor list where the running word count crosses each
+    // multiple of total/nthreads
+
+    i = 0;
+    njobs = 0;
+    for (t = 0; t < nthreads; ++t) {
+        target = total * (t+1) / nthreads;
+        jobs[njobs].descs = descs;
+        jobs[njobs].begin = i;
+        jobs[njobs].key = key;
+        jobs[njobs].fn = fn;
+        while (i < count && (acc < target || t == nthreads-1)) {
+            acc += descs[i].n < 0 ? -(int64_t)descs[i].n : descs[i].n;
+            ++i;
+        }
+        jobs[njobs].end = i;
+        if (jobs[njobs].end > jobs[njobs].begin) {
+            ++njobs;
+        }
+    }
+
+    xxtea_run_jobs(xxtea_batch_worker, jobs, sizeof(jobs[0]), njobs);
+}
+
+// ==== multi-lane (SIMD) API
+
+// Run W independent blocks of the same length n in lockstep, one block per
+// vector lane. The blocks are stored transposed (struct-of-arrays): word p of
+// lane l is at v[p*W + l]. Because every lane uses the same key, the key word
+// key[(p&3)^e] and (for AYB) the rnd32() keystream are the same for all lanes,
+// and are broadcast as scalars. The vector width that the compiler emits
+// (SSE2/AVX2/AVX-512) follows the -m flags, e.g. -mavx2 or -mavx512f. Use the
+// lane count that matches the native width: x4 for SSE2, x8 for AVX2, x16 for
+// AVX-512. A wider W than the target supports is lowered into narrower ops and
+// spills.
+//
+//  xxtea_x4(),  xxtea_x8(),  xxtea_x16():      same as xxtea()
+//  ayb_xxtea_x4(), ayb_xxtea_x8(), ayb_xxtea_x16(): same as ayb_xxtea()
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void xxtea_to_soa(uint32_t * soa, uint32_t * const * blocks, int n, unsigned lanes)
+{
+    unsigned p, l;
+
+    for (p = 0; p < (unsigned)n; ++p) {
+        for (l = 0; l < lanes; ++l) {
+            soa[p*lanes + l] = blocks[l][p];
+        }
+    }
+}
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void xxtea_from_soa(uint32_t * const * blocks, const uint32_t * soa, int n, unsigned lanes)
+{
+    unsigned p, l;
+
+    for (p = 0; p < (unsigned)n; ++p) {
+        for (l = 0; l < lanes; ++l) {
+            blocks[l][p] = soa[p*lanes + l];
+        }
+    }
+}
+
+#ifdef __GNUC__
+
+#define MXV     ( ((z>>5^y<<2) + (y>>3^z<<4)) ^ ((sum^y) + (key[(p&3)^e] ^ z)) )
+
+#define XXTEA_SIMD_DEF(W)                                                   \
+typedef uint32_t xxtea_v##W##_t __attribute__((vector_size(4*W)));          \
+                                                                            \
+GCC_ATTRIB(nonnull,nothrow,unused)                                          \
+static void xxtea_x##W(uint32_t * v, int n, const uint32_t key[4])          \
+{                                                                           \
+    xxtea_v##W##_t y, z, t;                                                 \
+    uint32_t sum;                                                           \
+    unsigned p, rounds, e;                                                  \
+                                                                            \
+    if (n > 1) {                                                            \
+        rounds = 6 + 52/n;                                                  \
+        sum = 0;                                                            \
+        memcpy(&z,&v[(n-1)*W],sizeof(z));                                   \
+        do {                                                                \
+            sum += DELTA;                                                   \
+            e = (sum >> 2) & 3;                                             \
+            for (p=0; p<(unsigned)n-1; p++) {                               \
+                memcpy(&y,&v[(p+1)*W],sizeof(y));                           \
+                memcpy(&t,&v[p*W],sizeof(t));                               \
+                z = t += MXV;                                               \
+                memcpy(&v[p*W],&t,sizeof(t));                               \
+            }                                                               \
+            memcpy(&y,&v[0],sizeof(y));                                     \
+            memcpy(&t,&v[p*W],sizeof(t));                                   \
+            z = t += MXV;                                                   \
+            memcpy(&v[p*W],&t,sizeof(t));                                   \
+        } while (--rounds);                                                 \
+    } else if (n < -1) {                                                    \
+        n = -n;                                                             \
+        rounds = 6 + 52/n;                                                  \
+        sum = rounds*DELTA;                                                 \
+        memcpy(&y,&v[0],sizeof(y));                                         \
+        do {                                                                \
+            e = (sum >> 2) & 3;                                             \
+            for (p=n-1; p>0; p--) {                                         \
+                memcpy(&z,&v[(p-1)*W],sizeof(z));                           \
+                memcpy(&t,&v[p*W],sizeof(t));                               \
+                y = t -= MXV;                                               \
+                memcpy(&v[p*W],&t,sizeof(t));                               \
+            }                                                               \
+            memcpy(&z,&v[(n-1)*W],sizeof(z));                               \
+            memcpy(&t,&v[0],sizeof(t));                                     \
+            y = t -= MXV;                                                   \
+            memcpy(&v[0],&t,sizeof(t));                                     \
+            sum -= DELTA;                                                   \
+        } while (--rounds);                                                 \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+GCC_ATTRIB(nonnull,nothrow,unused)                                          \
+static void ayb_xxtea_x##W(uint32_t * v, int n, const uint32_t key[4])      \
+{                                                                           \
+    xxtea_v##W##_t y, z, t;                                                 \
+    uint32_t sum;                                                           \
+    unsigned p, rounds, e;                                                  \
+    rnd32_t r_ctx;                                                          \
+                                                                            \
+    assert( n > 1 || n < -1 );                                              \
+    assert( ((key[0] != 0) + (key[1] != 0) + (key[2] != 0) + (key[3] != 0)) >= 2 ); \
+                                                                            \
+    ayb_rnd32_init(&r_ctx,key);                                             \
+                                                                            \
+    if (n > 1) {                                                            \
+        rounds = 12 + 128/n;                                                \
+        sum = 0;                                                            \
+        memcpy(&z,&v[(n-1)*W],sizeof(z));                                   \
+        do {                                                                \
+            sum += DELTA;                                                   \
+            e = (sum >> 2) & 3;                                             \
+            for (p=0; p<(unsigned)n-1; p++) {                               \
+                memcpy(&y,&v[(p+1)*W],sizeof(y));                           \
+                memcpy(&t,&v[p*W],sizeof(t));                               \
+                z = t += rnd32(&r_ctx) ^ MXV;                               \
+                memcpy(&v[p*W],&t,sizeof(t));                               \
+            }                                                               \
+            memcpy(&y,&v[0],sizeof(y));                                     \
+            memcpy(&t,&v[p*W],sizeof(t));                                   \
+            z = t += rnd32(&r_ctx) ^ MXV;                                   \
+            memcpy(&v[p*W],&t,sizeof(t));                                   \
+        } while (--rounds);                                                 \
+    } else {                                                                \
+        n = -n;                                                             \
+        rounds = 12 + 128/n;                                                \
+        ayb_rks_t rks;                                                      \
+        void * r_ws = XXTEA_MALLOC(ayb_rks_size(ayb_ks_count(n)));                 \
+        if (r_ws == 0) {                                                    \
+            PANIC("out of memory");                                         \
+        }                                                                   \
+        ayb_rks_init(&rks,&r_ctx,ayb_ks_count(n),r_ws);                            \
+        sum = rounds*DELTA;                                                 \
+        memcpy(&y,&v[0],sizeof(y));                                         \
+        do {                                                                \
+            e = (sum >> 2) & 3;                                             \
+            for (p=n-1; p>0; p--) {                                         \
+                memcpy(&z,&v[(p-1)*W],sizeof(z));                           \
+                memcpy(&t,&v[p*W],sizeof(t));                               \
+                y = t -= AYB_RKS_NEXT(&rks) ^ MXV;                          \
+                memcpy(&v[p*W],&t,sizeof(t));                               \
+            }                                                               \
+            memcpy(&z,&v[(n-1)*W],sizeof(z));                               \
+            memcpy(&t,&v[0],sizeof(t));                                     \
+            y = t -= AYB_RKS_NEXT(&rks) ^ MXV;                              \
+            memcpy(&v[0],&t,sizeof(t));                                     \
+            sum -= DELTA;                                                   \
+        } while (--rounds);                                                 \
+        XXTEA_FREE(r_ws);                                                   \
+    }                                                                       \
+}
+
+XXTEA_SIMD_DEF(4)
+XXTEA_SIMD_DEF(8)
+XXTEA_SIMD_DEF(16)
+
+#else // !__GNUC__: one lane at a time
+
+#define XXTEA_SIMD_DEF(W)                                                   \
+static void xxtea_soa_lanes_##W(xxtea_fn_t fn, uint32_t * v, int n, const uint32_t key[4]) \
+{                                                                           \
+    uint32_t * blocks[W];                                                   \
+    unsigned l, m = n < 0 ? -n : n;                                         \
+    uint32_t * buf = (uint32_t *)XXTEA_MALLOC(sizeof(uint32_t) * m*W);      \
+    if (buf == 0) {                                                         \
+        PANIC("out of memory");                                             \
+    }                                                                       \
+    for (l = 0; l < W; ++l) blocks[l] = &buf[l*m];                          \
+    xxtea_from_soa(blocks,v,m,W);                                           \
+    for (l = 0; l < W; ++l) fn(blocks[l],n,key);                            \
+    xxtea_to_soa(v,blocks,m,W);                                             \
+    XXTEA_FREE(buf);                                                        \
+}                                                                           \
+static void xxtea_x##W(uint32_t * v, int n, const uint32_t key[4])          \
+    { xxtea_soa_lanes_##W(xxtea,v,n,key); }                                 \
+static void ayb_xxtea_x##W(uint32_t * v, int n, const uint32_t key[4])      \
+    { xxtea_soa_lanes_##W(ayb_xxtea,v,n,key); }
+
+XXTEA_SIMD_DEF(4)
+XXTEA_SIMD_DEF(8)
+XXTEA_SIMD_DEF(16)
+
+#endif // __GNUC__
+
+// ==== wide-message mode
+
+// For a huge n every xxtea() round streams the whole message through the cache
+// on one core. The wide-message mode instead splits the message into
+// sub-blocks of ~XXTEA_WIDE_BLOCK words (4KB: L1 resident), encrypts them in
+// parallel, and binds them together with a mixing step, so that every
+// ciphertext word depends upon every plaintext word. It costs ~2x the
+// arithmetic of xxtea(), but every pass is parallel and cache resident.
+//
+// WIRE FORMAT (version 1), i.e. the definition of the transform:
+//
+//  m = max(1, floor(n / B)), B = XXTEA_WIDE_BLOCK = 1024, sub-block S_i is
+//  words [i*B, (i+1)*B) for i < m-1, and S_{m-1} is the rest, i.e. B..2B-1
+//  words. H(S) is words 0-3 of S. E() is xxtea_ctx_encrypt() with the given
+//  key and variant. T(j,i) xors the tweak (lo32(i), hi32(i) ^ (j << 24)) into
+//  words 0-1 of its argument. F(j,i,x) = E(T(j,i,x)), x is 4 words.
+//
+//  1. for all i:            S_i = E(T(1,i,S_i))
+//     if m == 1 then done
+//  2. s = xor of H(S_i), i = 1..m-1
+//     H(S_0) ^= F(2,0,s);   S_0 = E(T(2,0,S_0))
+//  3. t = H(S_0)
+//     for i = 1..m-1:       H(S_i) ^= F(3,i,t);  S_i = E(T(4,i,S_i))
+//
+// Decryption runs the inverse steps in reverse order: 3, 2, 1.
+
+#define XXTEA_WIDE_BLOCK 1024 // words
+
+typedef struct {
+    const xxtea_ctx_t * ctx;
+    uint32_t * v;
+    size_t n, m, begin, end;
+    int step, decrypt;
+    uint32_t t[4];
+} xxtea_wide_job_t;
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE void xxtea_wide_tweak(uint32_t * w, unsigned j, size_t i)
+{
+    w[0] ^= (uint32_t)i;
+    w[1] ^= (uint32_t)((uint64_t)i >> 32) ^ (j << 24);
+}
+
+// F(j,i,x) xor-ed into H(w)
+
+GCC_ATTRIB(nonnull,nothrow)
+static void xxtea_wide_mix(const xxtea_ctx_t * ctx, uint32_t * w, unsigned j, size_t i, const uint32_t x[4])
+{
+    uint32_t f[4];
+
+    memcpy(f,x,sizeof(f));
+    xxtea_wide_tweak(f,j,i);
+    xxtea_ctx_encrypt(ctx,f,4);
+    w[0] ^= f[0]; w[1] ^= f[1]; w[2] ^= f[2]; w[3] ^= f[3];
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE uint32_t * xxtea_wide_sub(const xxtea_wide_job_t * job, size_t i, int * len)
+{
+    *len = (int)(i == job->m-1 ? job->n - i*XXTEA_WIDE_BLOCK : XXTEA_WIDE_BLOCK);
+    return job->v + i*XXTEA_WIDE_BLOCK;
+}
+
+// steps 1 and 3 for sub-blocks [begin, end)
+
+GCC_ATTRIB(nonnull)
+static void * xxtea_wide_worker(void * arg)
+{
+    const xxtea_wide_job_t * job = (const xxtea_wide_job_t *)arg;
+    size_t i;
+    uint32_t * w;
+    int len;
+
+    for (i = job->begin; i < job->end; ++i) {
+        w = xxtea_wide_sub(job,i,&len);
+        if (job->step == 1) {
+            if (!job->decrypt) {
+                xxtea_wide_tweak(w,1,i);
+                xxtea_ctx_encrypt(job->ctx,w,len);
+            } else {
+                xxtea_ctx_decrypt(job->ctx,w,len);
+                xxtea_wide_tweak(w,1,i);
+            }
+        } else { // step 3
+            if (!job->decrypt) {
+                xxtea_wide_mix(job->ctx,w,3,i,job->t);
+                xxtea_wide_tweak(w,4,i);
+                xxtea_ctx_encrypt(job->ctx,w,len);
+            } else {
+                xxtea_ctx_decrypt(job->ctx,w,len);
+                xxtea_wide_tweak(w,4,i);
+                xxtea_wide_mix(job->ctx,w,3,i,job->t);
+            }
+        }
+    }
+
+    return 0;
+}
+
+GCC_ATTRIB(nonnull)
+static void xxtea_wide_step(xxtea_wide_job_t * proto, int step, size_t first, unsigned nthreads)
+{
+    xxtea_wide_job_t jobs[XXTEA_MAX_THREADS];
+    size_t count = proto->m - first;
+    unsigned t;
+
+    if (nthreads > count) {
+        nthreads = (unsigned)count;
+    }
+    for (t = 0; t < nthreads; ++t) {
+        jobs[t] = *proto;
+        jobs[t].step = step;
+        jobs[t].begin = first + count * t / nthreads;
+        jobs[t].end = first + count * (t+1) / nthreads;
+    }
+    xxtea_run_jobs(xxtea_wide_worker,jobs,sizeof(jobs[0]),nthreads);
+}
+
+// step 2: S_0 depends upon all of S_1..S_{m-1}
+
+GCC_ATTRIB(nonnull,nothrow)
+static void xxtea_wide_bind(const xxtea_wide_job_t * job)
+{
+    uint32_t s[4], * w;
+    size_t i;
+    int len;
+
+    memset(s,0,sizeof(s));
+    for (i = 1; i < job->m; ++i) {
+        w = xxtea_wide_sub(job,i,&len);
+        s[0] ^= w[0]; s[1] ^= w[1]; s[2] ^= w[2]; s[3] ^= w[3];
+    }
+
+    w = xxtea_wide_sub(job,0,&len);
+    if (!job->decrypt) {
+        xxtea_wide_mix(job->ctx,w,2,0,s);
+        xxtea_wide_tweak(w,2,0);
+        xxtea_ctx_encrypt(job->ctx,w,len);
+    } else {
+        xxtea_ctx_decrypt(job->ctx,w,len);
+        xxtea_wide_tweak(w,2,0);
+        xxtea_wide_mix(job->ctx,w,2,0,s);
+    }
+}
+
+GCC_ATTRIB(nonnull)
+static void xxtea_wide(const xxtea_ctx_t * ctx, uint32_t * v, size_t n, int decrypt, unsigned nthreads)
+{
+    xxtea_wide_job_t job;
+
+    assert(n > 1 && n/XXTEA_WIDE_BLOCK < ((size_t)1 << 56)); // i.e. the tweak is unique
+
+    job.ctx = ctx;
+    job.v = v;
+    job.n = n;
+    job.m = n < XXTEA_WIDE_BLOCK ? 1 : n / XXTEA_WIDE_BLOCK;
+    job.decrypt = decrypt;
+    nthreads = xxtea_nthreads(nthreads);
+
+    if (job.m == 1) {
+        xxtea_wide_step(&job,1,0,1);
+    } else if (!decrypt) {
+        xxtea_wide_step(&job,1,0,nthreads);
+        xxtea_wide_bind(&job);
+        memcpy(job.t,v,sizeof(job.t));
+        xxtea_wide_step(&job,3,1,nthreads);
+    } else {
+        memcpy(job.t,v,sizeof(job.t));
+        xxtea_wide_step(&job,3,1,nthreads);
+        xxtea_wide_bind(&job);
+        xxtea_wide_step(&job,1,0,nthreads);
+    }
+}
+
+GCC_ATTRIB(nonnull,unused)
+static void xxtea_wide_encrypt(const xxtea_ctx_t * ctx, uint32_t * v, size_t n, unsigned nthreads)
+{
+    xxtea_wide(ctx,v,n,0,nthreads);
+}
+
+GCC_ATTRIB(nonnull,unused)
+static void xxtea_wide_decrypt(const xxtea_ctx_t * ctx, uint32_t * v, size_t n, unsigned nthreads)
+{
+    xxtea_wide(ctx,v,n,1,nthreads);
+}
+
+// ==== fused crc32c
+
+// xxtea_ctx_encrypt_crc() and xxtea_ctx_decrypt_crc() return the CRC32C
+// (Castagnoli) of the plaintext bytes, computed in the same pass as the cipher
+// instead of in a second pass over the buffer. Encrypt reads the plaintext in
+// its first round, in order, so each chunk of XXTEA_CRC_CHUNK words is
+// checksummed just before the first round encrypts it, i.e. while it is in L1.
+// Decrypt produces the plaintext in its last round, in reverse order, so each
+// chunk is checksummed right after the last round finishes it, and the chunk
+// checksums are combined back to front, as in zlib's crc32_combine(). The crc
+// uses the SSE4.2 or ARMv8 crc32c instructions when the target has them
+// (e.g. -msse4.2, -march=native), else a table.
+
+#define XXTEA_CRC_CHUNK 256 // words
+#define CRC32C_POLY     UINT32_C(0x82f63b78) // reflected
+
+static uint32_t crc32c_table[256];
+static uint32_t crc32c_x2n[32]; // x^(2^k) mod p(x)
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+// a*b mod p(x), reflected
+
+GCC_ATTRIB(const,nothrow)
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = UINT32_C(1) << 31, p = 0;
+
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+
+    return p;
+}
+
+static void crc32c_init()
+{
+    uint32_t c;
+    unsigned i, j;
+
+    for (i = 0; i < 256; ++i) {
+        c = i;
+        for (j = 0; j < 8; ++j) {
+            c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        }
+        crc32c_table[i] = c;
+    }
+
+    crc32c_x2n[0] = UINT32_C(1) << 30; // x^1
+    for (i = 1; i < 32; ++i) {
+        crc32c_x2n[i] = crc32c_multmodp(crc32c_x2n[i-1],crc32c_x2n[i-1]);
+    }
+}
+
+// x^(8*len) mod p(x)
+
+GCC_ATTRIB(nothrow)
+static uint32_t crc32c_x8nmodp(uint64_t len)
+{
+    uint32_t p = UINT32_C(1) << 31; // x^0
+    unsigned k = 3;
+
+    pthread_once(&crc32c_once,crc32c_init);
+    for (; len; len >>= 1, ++k) {
+        if (len & 1) {
+            p = crc32c_multmodp(crc32c_x2n[k & 31],p);
+        }
+    }
+
+    return p;
+}
+
+// raw update: no pre/post inversion
+
+GCC_ATTRIB(nonnull,nothrow)
+static uint32_t crc32c_update(uint32_t crc, const void * buf, size_t len)
+{
+    const unsigned char * p = (const unsigned char *)buf;
+
+#if defined(__SSE4_2__)
+    uint64_t c = crc, x;
+    for (; len >= 8; len -= 8, p += 8) {
+        memcpy(&x,p,8);
+        c = _mm_crc32_u64(c,x);
+    }
+    crc = (uint32_t)c;
+    for (; len; --len) {
+        crc = _mm_crc32_u8(crc,*p++);
+    }
+#elif defined(__ARM_FEATURE_CRC32)
+    uint64_t x;
+    for (; len >= 8; len -= 8, p += 8) {
+        memcpy(&x,p,8);
+        crc = __crc32cd(crc,x);
+    }
+    for (; len; --len) {
+        crc = __crc32cb(crc,*p++);
+    }
+#else
+    pthread_once(&crc32c_once,crc32c_init);
+    for (; len; --len) {
+        crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+#endif
+
+    return crc;
+}
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE uint32_t crc32c(const void * buf, size_t len)
+{
+    return ~crc32c_update(~UINT32_C(0),buf,len);
+}
+
+// crc32c(A || B) from crc32c(A), crc32c(B), and x^(8*len(B)) mod p(x)
+
+GCC_ATTRIB(const,nothrow)
+INLINE uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint32_t x8n_b)
+{
+    return crc32c_multmodp(x8n_b,crc_a) ^ crc_b;
+}
+
+GCC_ATTRIB(nonnull,nothrow,always_inline)
+INLINE uint32_t xxtea_ctx_crypt_crc(const xxtea_ctx_t * ctx, uint32_t * v, int n, const int ayb)
+{
+    uint32_t y, z, sum, crc;
+    const uint32_t * k;
+    unsigned p, q, q_end, e, rounds;
+    rnd32_t r_ctx = ctx->r_init;
+    ayb_rks_t rks;
+    void * r_ws = 0;
+
+    #define XXTEA_CRC_R(expr) (ayb ? (expr) : 0)
+
+    if (n > 1) {
+        rounds = ayb ? 12 + 128/n : 6 + 52/n;
+        sum = 0;
+        z = v[n-1];
+
+        // round 1: checksum each chunk, then encrypt it
+        crc = ~UINT32_C(0);
+        sum += DELTA;
+        e = (sum >> 2) & 3;
+        k = ctx->k[e];
+        for (q = 0; q < (unsigned)n; q = q_end) {
+            q_end = q + XXTEA_CRC_CHUNK < (unsigned)n ? q + XXTEA_CRC_CHUNK : (unsigned)n;
+            crc = crc32c_update(crc,v+q,(q_end-q)*sizeof(v[0]));
+            for (p=q; p<q_end && p<(unsigned)n-1; p++) {
+                y = v[p+1];
+                z = v[p] += XXTEA_CRC_R(rnd32(&r_ctx)) ^ MXK(k[p&3]);
+            }
+        }
+        y = v[0];
+        z = v[n-1] += XXTEA_CRC_R(rnd32(&r_ctx)) ^ MXK(k[p&3]);
+        crc = ~crc;
+
+        while (--rounds) {
+            sum += DELTA;
+            e = (sum >> 2) & 3;
+            k = ctx->k[e];
+            for (p=0; p<(unsigned)n-1; p++) {
+                y = v[p+1];
+                z = v[p] += XXTEA_CRC_R(rnd32(&r_ctx)) ^ MXK(k[p&3]);
+            }
+            y = v[0];
+            z = v[n-1] += XXTEA_CRC_R(rnd32(&r_ctx)) ^ MXK(k[p&3]);
+        }
+    } else {
+        uint32_t x8n, x8n_chunk;
+
+        assert(n < -1);
+
+        n = -n;
+        rounds = ayb ? 12 + 128/n : 6 + 52/n;
+        if (ayb) {
+            r_ws = XXTEA_MALLOC(ayb_rks_size(ayb_ks_count(n)));
+            if (r_ws == 0) {
+                PANIC("out of memory");
+            }
+            ayb_rks_init(&rks,&r_ctx,ayb_ks_count(n),r_ws);
+        }
+        sum = rounds*DELTA;
+        y = v[0];
+
+        while (rounds-- > 1) {
+            e = (sum >> 2) & 3;
+            k = ctx->k[e];
+            for (p=n-1; p>0; p--) {
+                z = v[p-1];
+                y = v[p] -= XXTEA_CRC_R(AYB_RKS_NEXT(&rks)) ^ MXK(k[p&3]);
+            }
+            z = v[n-1];
+            y = v[0] -= XXTEA_CRC_R(AYB_RKS_NEXT(&rks)) ^ MXK(k[0]);
+            sum -= DELTA;
+        }
+
+        // last round: decrypt each chunk, back to front, then checksum it
+        crc = 0; // crc32c of the empty suffix
+        x8n = UINT32_C(1) << 31; // x^(8*len(suffix))
+        x8n_chunk = crc32c_x8nmodp(XXTEA_CRC_CHUNK*sizeof(v[0]));
+        e = (sum >> 2) & 3;
+        k = ctx->k[e];
+        for (q_end = n; q_end > 0; q_end = q) {
+            q = (q_end-1) / XXTEA_CRC_CHUNK * XXTEA_CRC_CHUNK;
+            for (p=q_end-1; p>q || (p>0 && p==q); p--) {
+                z = v[p-1];
+                y = v[p] -= XXTEA_CRC_R(AYB_RKS_NEXT(&rks)) ^ MXK(k[p&3]);
+            }
+            if (q == 0) {
+                z = v[n-1];
+                y = v[0] -= XXTEA_CRC_R(AYB_RKS_NEXT(&rks)) ^ MXK(k[0]);
+            }
+            crc = crc32c_combine(crc32c(v+q,(q_end-q)*sizeof(v[0])),crc,x8n);
+            x8n = crc32c_multmodp(x8n,q_end-q == XXTEA_CRC_CHUNK ? x8n_chunk
+                : crc32c_x8nmodp((q_end-q)*sizeof(v[0])));
+        }
+        XXTEA_FREE(r_ws);
+    }
+
+    #undef XXTEA_CRC_R
+
+    return crc;
+}
+
+// same as xxtea_ctx_encrypt(), returns crc32c() of the plaintext
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static uint32_t xxtea_ctx_encrypt_crc(const xxtea_ctx_t * ctx, uint32_t * v, int n)
+{
+    assert(n > 1);
+    return ctx->ayb ? xxtea_ctx_crypt_crc(ctx,v,n,1) : xxtea_ctx_crypt_crc(ctx,v,n,0);
+}
+
+// same as xxtea_ctx_decrypt(), returns crc32c() of the plaintext
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static uint32_t xxtea_ctx_decrypt_crc(const xxtea_ctx_t * ctx, uint32_t * v, int n)
+{
+    assert(n > 1);
+    return ctx->ayb ? xxtea_ctx_crypt_crc(ctx,v,-n,1) : xxtea_ctx_crypt_crc(ctx,v,-n,0);
+}
+
+// ==== block cipher modes: CTR, CBC
+
+// A mode layer over xxtea_ctx_t with a fixed block length of n = 2..16 words,
+// i.e. bs = 4n bytes. Words are in host byte order, as everywhere in this file.
+//
+//  CTR: C_i = P_i ^ E(T(iv,ctr+i)), where T() xors the 64-bit block counter
+//       into words 0-1 of the iv. Encrypt == decrypt. Every block is
+//       independent, so both directions run in parallel. The last block may be
+//       partial, i.e. there is no padding.
+//  CBC: C_i = E(P_i ^ C_{i-1}), C_{-1} = iv, with PKCS#7 padding. Encrypt is
+//       serial, but decrypt, P_i = D(C_i) ^ C_{i-1}, runs in parallel.
+//
+// Streaming: xxtea_mode_init(), xxtea_mode_update() any number of times, then
+// xxtea_mode_final(). update() passes runs of >= XXTEA_MODE_PAR_MIN bytes of
+// whole blocks to the bulk path with the nthreads of the stream. Bulk:
+// xxtea_ctr() and xxtea_cbc_decrypt() process a whole buffer on nthreads
+// threads (0 ==> one per cpu), in place or not.
+
+#define XXTEA_MODE_MAX_N    16 // words
+#define XXTEA_MODE_PAR_MIN  (256 << 10) // bytes
+#define XXTEA_MODE_WS_MAX   (sizeof(rnd32_t) + XXTEA_FIXED_KS_MAX*sizeof(uint32_t)) // >= ayb_xxtea_ws_size(n <= 16)
+
+enum { XXTEA_CTR, XXTEA_CBC_ENCRYPT, XXTEA_CBC_DECRYPT };
+
+typedef struct {
+    const xxtea_ctx_t * ctx;
+    int mode;
+    unsigned n, nthreads;
+    uint64_t ctr;                           // CTR: counter of the next block
+    uint32_t iv[XXTEA_MODE_MAX_N];          // CTR: nonce, CBC: previous cipher text block
+    unsigned char buf[4*XXTEA_MODE_MAX_N];  // CTR: key stream, CBC: partial block
+    unsigned buf_len;                       // CTR: unused key stream bytes at the end of buf
+} xxtea_mode_t;
+
+typedef struct {
+    const xxtea_ctx_t * ctx;
+    const unsigned char * in;
+    unsigned char * out;
+    size_t len, begin, end;                 // len: bytes, [begin, end): blocks
+    unsigned n;
+    uint64_t ctr;                           // CTR: counter of block 0
+    uint32_t iv[XXTEA_MODE_MAX_N];          // CTR: nonce, CBC: C_{begin-1}
+} xxtea_mode_job_t;
+
+// D() without touching the allocator, even for AYB with n != 2, 4, 8, 16
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE void xxtea_mode_decrypt_block(const xxtea_ctx_t * ctx, uint32_t * b, unsigned n)
+{
+    uint64_t ws[XXTEA_MODE_WS_MAX/sizeof(uint64_t) + 1];
+    int rc = xxtea_ctx_decrypt_ws(ctx,b,n,ws,sizeof(ws));
+
+    assert(rc == 0);
+    (void)rc;
+}
+
+// key stream block E(T(iv,ctr))
+
+GCC_ATTRIB(nonnull,nothrow)
+INLINE void xxtea_ctr_block(const xxtea_ctx_t * ctx, const uint32_t * iv, unsigned n, uint64_t ctr, uint32_t * ks)
+{
+    memcpy(ks,iv,4*n);
+    ks[0] ^= (uint32_t)ctr;
+    ks[1] ^= (uint32_t)(ctr >> 32);
+    xxtea_ctx_encrypt(ctx,ks,n);
+}
+
+GCC_ATTRIB(nonnull)
+static void * xxtea_ctr_worker(void * arg)
+{
+    const xxtea_mode_job_t * job = (const xxtea_mode_job_t *)arg;
+    const unsigned bs = 4*job->n;
+    uint32_t ks[XXTEA_MODE_MAX_N], x[XXTEA_MODE_MAX_N];
+    size_t i, off, len;
+    unsigned k;
+
+    for (i = job->begin; i < job->end; ++i) {
+        off = i*bs;
+        len = job->len - off < bs ? job->len - off : bs;
+        xxtea_ctr_block(job->ctx,job->iv,job->n,job->ctr + i,ks);
+        if (len < bs) {
+            memset(x,0,sizeof(x));
+        }
+        memcpy(x,job->in + off,len);
+        for (k = 0; k < job->n; ++k) {
+            x[k] ^= ks[k];
+        }
+        memcpy(job->out + off,x,len);
+    }
+
+    return 0;
+}
+
+GCC_ATTRIB(nonnull)
+static void * xxtea_cbc_decrypt_worker(void * arg)
+{
+    const xxtea_mode_job_t * job = (const xxtea_mode_job_t *)arg;
+    const unsigned bs = 4*job->n;
+    uint32_t prev[XXTEA_MODE_MAX_N], c[XXTEA_MODE_MAX_N], p[XXTEA_MODE_MAX_N];
+    size_t i;
+    unsigned k;
+
+    memcpy(prev,job->iv,bs);
+    for (i = job->begin; i < job->end; ++i) {
+        memcpy(c,job->in + i*bs,bs);
+        memcpy(p,c,bs);
+        xxtea_mode_decrypt_block(job->ctx,p,job->n);
+        for (k = 0; k < job->n; ++k) {
+            p[k] ^= prev[k];
+        }
+        memcpy(job->out + i*bs,p,bs);
+        memcpy(prev,c,bs);
+    }
+
+    return 0;
+}
+
+// split blocks [0, nblocks) of proto across nthreads threads
+
+GCC_ATTRIB(nonnull)
+static void xxtea_mode_bulk(void * (*fn)(void *), const xxtea_mode_job_t * proto, size_t nblocks, unsigned nthreads)
+{
+    xxtea_mode_job_t jobs[XXTEA_MAX_THREADS];
+    const unsigned bs = 4*proto->n;
+    unsigned t;
+
+    nthreads = xxtea_nthreads(nthreads);
+    if (nthreads > nblocks) {
+        nthreads = (unsigned)nblocks;
+    }
+    for (t = 0; t < nthreads; ++t) {
+        jobs[t] = *proto;
+        jobs[t].begin = nblocks * t / nthreads;
+        jobs[t].end = nblocks * (t+1) / nthreads;
+        if (fn == xxtea_cbc_decrypt_worker && jobs[t].begin > 0) {
+            // read C_{begin-1} before another thread overwrites it in place
+            memcpy(jobs[t].iv,proto->in + (jobs[t].begin-1)*bs,bs);
+        }
+    }
+    xxtea_run_jobs(fn,jobs,sizeof(jobs[0]),nthreads);
+}
+
+// CTR encrypt == decrypt of len bytes, the first block with counter ctr
+
+GCC_ATTRIB(nonnull,unused)
+static void xxtea_ctr(const xxtea_ctx_t * ctx, unsigned n, const uint32_t * iv, uint64_t ctr,
+    const void * in, void * out, size_t len, unsigned nthreads)
+{
+    xxtea_mode_job_t job;
+
+    assert(n >= 2 && n <= XXTEA_MODE_MAX_N);
+
+    job.ctx = ctx;
+    job.in = (const unsigned char *)in;
+    job.out = (unsigned char *)out;
+    job.len = len;
+    job.n = n;
+    job.ctr = ctr;
+    memcpy(job.iv,iv,4*n);
+    xxtea_mode_bulk(xxtea_ctr_worker,&job,(len + 4*n - 1) / (4*n),nthreads);
+}
+
+// CBC decrypt of nblocks whole blocks, without removing the padding
+
+GCC_ATTRIB(nonnull,unused)
+static void xxtea_cbc_decrypt(const xxtea_ctx_t * ctx, unsigned n, const uint32_t * iv,
+    const void * in, void * out, size_t nblocks, unsigned nthreads)
+{
+    xxtea_mode_job_t job;
+
+    assert(n >= 2 && n <= XXTEA_MODE_MAX_N);
+
+    job.ctx = ctx;
+    job.in = (const unsigned char *)in;
+    job.out = (unsigned char *)out;
+    job.len = nblocks*4*n;
+    job.n = n;
+    job.ctr = 0;
+    memcpy(job.iv,iv,4*n);
+    xxtea_mode_bulk(xxtea_cbc_decrypt_worker,&job,nblocks,nthreads);
+}
+
+// mode: XXTEA_CTR, XXTEA_CBC_ENCRYPT or XXTEA_CBC_DECRYPT; iv: n words
+
+GCC_ATTRIB(nonnull,nothrow,unused)
+static void xxtea_mode_init(xxtea_mode_t * m, const xxtea_ctx_t * ctx, int mode, unsigned n,
+    const uint32_t * iv, unsigned nthreads)
+{
+    assert(n >= 2 && n <= XXTEA_MODE_MAX_N);
+    assert(mode == XXTEA_CTR || mode == XXTEA_CBC_ENCRYPT || mode == XXTEA_CBC_DECRYPT);
+
+    memset(m,0,sizeof(*m));
+    m->ctx = ctx;
+    m->mode = mode;
+    m->n = n;
+    m->nthreads = nthreads;
+    memcpy(m->iv,iv,4*n);
+}
+
+// CBC encrypt of nblocks whole blocks: serial
+
+GCC_ATTRIB(nonnull,nothrow)
+static void xxtea_mode_cbc_encrypt(xxtea_mode_t * m, const unsigned char * in, unsigned char * out, size_t nblocks)
+{
+    const unsigned bs = 4*m->n;
+    uint32_t x[XXTEA_MODE_MAX_N];
+    size_t i;
+    unsigned k;
+
+    for (i = 0; i < nblocks; ++i) {
+        memcpy(x,in + i*bs,bs);
+        for (k = 0; k < m->n; ++k) {
+            x[k] ^= m->iv[k];
+        }
+        xxtea_ctx_encrypt(m->ctx,x,m->n);
+        memcpy(out + i*bs,x,bs);
+        memcpy(m->iv,x,bs);
+    }
+}
+
+// Returns the number of bytes written to out: len for CTR, else a multiple of
+// the block size, < len + 4n. CBC decrypt holds back the last block, which may
+// be padding, until the next update() or final(). For CTR out may equal in,
+// else they must not overlap.
+
+GCC_ATTRIB(nonnull,unused)
+static size_t xxtea_mode_update(xxtea_mode_t * m, const void * in_, void * out_, size_t len)
+{
+    const unsigned char * in = (const unsigned char *)in_;
+    unsigned char * out = (unsigned char *)out_;
+    const unsigned bs = 4*m->n;
+    size_t w = 0, nb, k;
+
+    if (m->mode == XXTEA_CTR) {
+        uint32_t ks[XXTEA_MODE_MAX_N];
+
+        for (; len > 0 && m->buf_len > 0; --len) {
+            out[w] = in[w] ^ m->buf[bs - m->buf_len--];
+            ++w;
+        }
+        nb = len / bs;
+        if (nb > 0) {
+            xxtea_ctr(m->ctx,m->n,m->iv,m->ctr,in + w,out + w,nb*bs,nb*bs >= XXTEA_MODE_PAR_MIN ? m->nthreads : 1);
+            m->ctr += nb;
+            w += nb*bs;
+            len -= nb*bs;
+        }
+        if (len > 0) {
+            xxtea_ctr_block(m->ctx,m->iv,m->n,m->ctr++,ks);
+            memcpy(m->buf,ks,bs);
+            m->buf_len = bs;
+            for (; len > 0; --len) {
+                out[w] = in[w] ^ m->buf[bs - m->buf_len--];
+                ++w;
+            }
+        }
+        return w;
+    }
+
+    while (len > 0) {
+        if (m->mode == XXTEA_CBC_ENCRYPT) {
+            if (m->buf_len == 0 && len >= bs) {
+                nb = len / bs;
+                xxtea_mode_cbc_encrypt(m,in,out + w,nb);
+                in += nb*bs;
+                len -= nb*bs;
+                w += nb*bs;
+                continue;
+            }
+        } else {
+            if (m->buf_len == bs) {
+                // more input follows, so the buffered block is not the last
+                xxtea_cbc_decrypt(m->ctx,m->n,m->iv,m->buf,out + w,1,1);
+                memcpy(m->iv,m->buf,bs);
+                w += bs;
+                m->buf_len = 0;
+            }
+            if (m->buf_len == 0 && len > bs) {
+                nb = (len - 1) / bs; // keep >= 1 byte, i.e. the last block
+                xxtea_cbc_decrypt(m->ctx,m->n,m->iv,in,out + w,nb,nb*bs >= XXTEA_MODE_PAR_MIN ? m->nthreads : 1);
+                memcpy(m->iv,in + (nb-1)*bs,bs);
+                in += nb*bs;
+                len -= nb*bs;
+                w += nb*bs;
+            }
+        }
+
+        k = bs - m->buf_len < len ? bs - m->buf_len : len;
+        memcpy(m->buf + m->buf_len,in,k);
+        m->buf_len += (unsigned)k;
+        in += k;
+        len -= k;
+
+        if (m->mode == XXTEA_CBC_ENCRYPT && m->buf_len == bs) {
+            xxtea_mode_cbc_encrypt(m,m->buf,out + w,1);
+            w += bs;
+            m->buf_len = 0;
+        }
+    }
+
+    return w;
+}
+
+// Returns the number of bytes written to out, which must have room for 4n
+// bytes: 0 for CTR, 4n for CBC encrypt (the padding block), 0..4n-1 for CBC
+// decrypt, or -1 if the CBC decrypt input length is not a non-zero multiple of
+// the block size, or the padding is invalid.
+
+GCC_ATTRIB(nonnull,unused)
+static int xxtea_mode_final(xxtea_mode_t * m, void * out)
+{
+    const unsigned bs = 4*m->n;
+    unsigned char b[4*XXTEA_MODE_MAX_N];
+    unsigned pad, k;
+
+    if (m->mode == XXTEA_CTR) {
+        return 0;
+    }
+
+    if (m->mode == XXTEA_CBC_ENCRYPT) {
+        pad = bs - m->buf_len;
+        memset(m->buf + m->buf_len,(int)pad,pad);
+        xxtea_mode_cbc_encrypt(m,m->buf,(unsigned char *)out,1);
+        m->buf_len = 0;
+        return (int)bs;
+    }
+
+    if (m->buf_len != bs) {
+        return -1;
+    }
+    xxtea_cbc_decrypt(m->ctx,m->n,m->iv,m->buf,b,1,1);
+    m->buf_len = 0;
+    pad = b[bs-1];
+    if (pad == 0 || pad > bs) {
+        return -1;
+    }
+    for (k = bs - pad; k < bs; ++k) {
+        if (b[k] != pad) {
+            return -1;
+        }
+    }
+    memcpy(out,b,bs - pad);
+
+    return (int)(bs - pad);
+}
+
+// ==== ragged record batch
+
+// xxtea_records() encrypts or decrypts many small records of varying length in
+// place, e.g. 8..256 byte database column values, where one xxtea() call per
+// record is dominated by the per-call overhead and by the branches on n.
+// Records are bucketed by word count as they are scanned; as soon as a bucket
+// holds XXTEA_REC_W records they are transposed into a SoA block and run
+// through the multi-lane kernel, and the results are scattered back. Partial
+// buckets are flushed at the end with idle lanes. Records longer than
+// XXTEA_REC_MAX_N words go one at a time through xxtea()/ayb_xxtea(). Needs no
+// allocation except for those long unaligned records, and the AYB decrypt
+// reverse keystream of the lane kernels.
+//
+// Record i is buf[off[i], off[i+1]): its length must be a multiple of 4 bytes,
+// and >= 8. Records need no alignment. Words are in host byte order.
+
+#ifndef XXTEA_REC_MAX_N
+#define XXTEA_REC_MAX_N 64 // words
+#endif
+
+// lanes: the native vector width, see the multi-lane (SIMD) API
+#if defined(__AVX512F__)
+#define XXTEA_REC_W 16
+#elif defined(__AVX2__)
+#define XXTEA_REC_W 8
+#else
+#define XXTEA_REC_W 4
+#endif
+
+#define XXTEA_REC_CAT_(a,b) a##b
+#define XXTEA_REC_CAT(a,b) XXTEA_REC_CAT_(a,b)
+
+typedef struct {
+    unsigned char * buf;
+    const size_t * off;
+    const uint32_t * key;
+    xxtea_fn_t lanes;                   // xxtea_xW() or ayb_xxtea_xW()
+    int sign;                           // 1: encrypt, -1: decrypt
+    uint32_t soa[XXTEA_REC_MAX_N*XXTEA_REC_W];
+} xxtea_rec_t;
+
+// run k <= XXTEA_REC_W records of n words, idx[0..k-1], through the lanes
+
+GCC_ATTRIB(nonnull,nothrow)
+static void xxtea_rec_flush(xxtea_rec_t * rec, const size_t * idx, unsigned k, unsigned n)
+{
+    unsigned l, p;
+    const unsigned char * r;
+
+    if (k < XXTEA_REC_W) {
+        memset(rec->soa,0,sizeof(rec->soa[0])*n*XXTEA_REC_W);
+    }
+    for (l = 0; l < k; ++l) {
+        r = rec->buf + rec->off[idx[l]];
+        for (p = 0; p < n; ++p) {
+            memcpy(&rec->soa[p*XXTEA_REC_W + l],r + 4*p,4);
+        }
+    }
+
+    rec->lanes(rec->soa,rec->sign*(int)n,rec->key);
+
+    for (l = 0; l < k; ++l) {
+        unsigned char * w = rec->buf + rec->off[idx[l]];
+        for (p = 0; p < n; ++p) {
+            memcpy(w + 4*p,&rec->soa[p*XXTEA_REC_W + l],4);
+        }
+    }
+}
+
+GCC_ATTRIB(nonnull,unused)
+static void xxtea_records(unsigned char * buf, const size_t * off, size_t count,
+    const uint32_t key[4], int ayb, int decrypt)
+{
+    xxtea_rec_t rec;
+    size_t pend[XXTEA_REC_MAX_N+1][XXTEA_REC_W];
+    unsigned npend[XXTEA_REC_MAX_N+1];
+    size_t i, len;
+    unsigned n;
+
+    rec.buf = buf;
+    rec.off = off;
+    rec.key = key;
+    rec.lanes = ayb ? XXTEA_REC_CAT(ayb_xxtea_x,XXTEA_REC_W) : XXTEA_REC_CAT(xxtea_x,XXTEA_REC_W);
+    rec.sign = decrypt ? -1 : 1;
+    memset(npend,0,sizeof(npend));
+
+    for (i = 0; i < count; ++i) {
+        len = off[i+1] - off[i];
+        assert(off[i+1] >= off[i] && len % 4 == 0 && len >= 8);
+
+        n = len <= 4*XXTEA_REC_MAX_N ? (unsigned)(len / 4) : 0;
+        if (n == 0) {
+            // too long for a bucket
+            xxtea_fn_t fn = ayb ? ayb_xxtea : xxtea;
+            uint32_t * v = (uint32_t *)(buf + off[i]);
+            int m = rec.sign*(int)(len / 4);
+
+            if (((uintptr_t)v & (sizeof(uint32_t)-1)) == 0) {
+                fn(v,m,key);
+            } else {
+                v = (uint32_t *)XXTEA_MALLOC(len);
+                if (v == 0) {
+                    PANIC("out of memory");
+                }
+                memcpy(v,buf + off[i],len);
+                fn(v,m,key);
+                memcpy(buf + off[i],v,len);
+                XXTEA_FREE(v);
+            }
+            continue;
+        }
+
+        pend[n][npend[n]++] = i;
+        if (npend[n] == XXTEA_REC_W) {
+            xxtea_rec_flush(&rec,pend[n],XXTEA_REC_W,n);
+            npend[n] = 0;
+        }
+    }
+
+    for (n = 2; n <= XXTEA_REC_MAX_N; ++n) {
+        if (npend[n] > 0) {
+            xxtea_rec_flush(&rec,pend[n],npend[n],n);
+        }
+    }
+}
+
+#ifndef XXTEA_NO_MAIN // i.e. when included by a benchmark or tool
+
+typedef struct {
+    ayb_ks_cache_t * cache;
+    const uint32_t * key;
+} ayb_ks_cache_test_t;
+
+static void * ayb_ks_cache_test_worker(void * arg)
+{
+    const ayb_ks_cache_test_t * job = (const ayb_ks_cache_test_t *)arg;
+    ayb_ks_entry_t * entry = ayb_ks_cache_get(job->cache,job->key,1 << 14);
+
+    if (entry) {
+        ayb_ks_cache_release(job->cache,entry);
+    }
+    return 0;
+}
+
+int main(int argc, const char * argv[])
+{
+    const uint32_t key[4] = { 0xaabbccdd, 0x1eeff001, 0x22334455, 0x96677889 };
+
+    #define N8 32
+    #define N32 (N8/4)
+    const unsigned char plaintext[N8] = {
+        'a','b','c','d','e','f','g','h',
+        'i','j','k','l','m','n','o','p',
+        'q','r','s','t','u','v','w','x',
+        'y','z','0','1','2','3','4',0
+    };
+
+    unsigned char buf[N8];
+    int i;
+
+    assert(N8 >= 32 && N8%4 == 0);
+
+    printf("xxtea-original:\n");
+    memcpy(buf,plaintext,N8);
+    xxtea((uint32_t *)buf,N32,key);
+    xxtea((uint32_t *)buf,-N32,key);
+    for (i = 0; i < N8; ++i) {
+        printf("%2d: %c\n",i,buf[i]);
+    }
+    printf("\n");
+
+    printf("xxtea-ayb:\n");
+    memcpy(buf,plaintext,N8);
+    ayb_xxtea((uint32_t *)buf,N32,key);
+    ayb_xxtea((uint32_t *)buf,-N32,key);
+    for (i = 0; i < N8; ++i) {
+        printf("%2d: %c\n",i,buf[i]);
+    }
+    printf("\n");
+
+    {
+        #define NDESC 1000
+        static uint32_t words[NDESC*100];
+        xxtea_desc_t descs[NDESC];
+        size_t j, k, nwords = 0;
+
+        for (j = 0; j < NDESC; ++j) {
+            descs[j].v = &words[nwords];
+            descs[j].n = 2 + (int)(j*j % 97);
+            nwords += descs[j].n;
+        }
+        for (k = 0; k < nwords; ++k) {
+            words[k] = (uint32_t)(k * DELTA);
+        }
+
+        xxtea_batch(ayb_xxtea,descs,NDESC,key,4);
+        for (j = 0; j < NDESC; ++j) {
+            descs[j].n = -descs[j].n;
+        }
+        xxtea_batch(ayb_xxtea,descs,NDESC,key,4);
+
+        for (k = 0; k < nwords && words[k] == (uint32_t)(k * DELTA); ++k) {}
+        printf("xxtea-batch: %s\n\n", k == nwords ? "ok" : "FAILED");
+    }
+
+    {
+        // every lane must match the scalar result for the same block
+
+        #define NLANES 16
+        #define NW 5
+        static uint32_t blk[2][NLANES][NW], soa[NLANES*NW];
+        uint32_t * blocks[NLANES];
+        unsigned l, p, bad = 0;
+
+        for (l = 0; l < NLANES; ++l) {
+            for (p = 0; p < NW; ++p) {
+                blk[0][l][p] = blk[1][l][p] = l*NW + p;
+            }
+            blocks[l] = &blk[0][l][0];
+            ayb_xxtea(&blk[1][l][0],NW,key);
+        }
+
+        xxtea_to_soa(soa,blocks,NW,NLANES);
+        ayb_xxtea_x16(soa,NW,key);
+        xxtea_from_soa(blocks,soa,NW,NLANES);
+        bad += memcmp(blk[0],blk[1],sizeof(blk[0])) != 0;
+        ayb_xxtea_x16(soa,-NW,key);
+        xxtea_from_soa(blocks,soa,NW,NLANES);
+
+        for (l = 0; l < NLANES; ++l) {
+            for (p = 0; p < NW; ++p) {
+                blk[1][l][p] = l*NW + p;
+            }
+            xxtea(&blk[1][l][0],NW,key);
+        }
+        xxtea_to_soa(soa,blocks,NW,NLANES);
+        xxtea_x16(soa,NW,key);
+        xxtea_from_soa(blocks,soa,NW,NLANES);
+        bad += memcmp(blk[0],blk[1],sizeof(blk[0])) != 0;
+        xxtea_x16(soa,-NW,key);
+        xxtea_from_soa(blocks,soa,NW,NLANES);
+
+        for (l = 0; l < NLANES; ++l) {
+            for (p = 0; p < NW; ++p) {
+                bad += blk[0][l][p] != l*NW + p;
+            }
+        }
+        printf("xxtea-simd: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    {
+        // the decrypt segment length is ceil(sqrt(count)), and the workspace
+        // fits ceil(count/seg_len) checkpoints, up to UINT_MAX; the longest
+        // keystream is walked once (~10s), in a workspace of exactly
+        // ayb_rks_size() bytes
+
+        const unsigned counts[] = { AYB_RKS_FLAT_MAX + 1, 65535u*65535u, 65535u*65535u + 1, 65536u*65535u, 0xfffe0001u,
+            0xfffe0002u, 0xfffffffeu, 0xffffffffu };
+        const unsigned count = 0xffffffffu;
+        ayb_rks_t rks;
+        rnd32_t r_ctx = { 0, 0, 0xb5ad4eceda1ce2a9ULL };
+        void * ws;
+        unsigned j, bad = 0;
+
+        for (j = 0; j < sizeof(counts)/sizeof(counts[0]); ++j) {
+            uint64_t s = ayb_rks_seg_len(counts[j]), nseg = (counts[j] + s - 1) / s;
+            bad += !((s-1)*(s-1) < counts[j] && counts[j] <= s*s);
+            bad += ayb_rks_size(counts[j]) != nseg*sizeof(rnd32_t) + s*sizeof(uint32_t);
+        }
+        if ((ws = XXTEA_MALLOC(ayb_rks_size(count))) == 0) {
+            PANIC("out of memory");
+        }
+        ayb_rks_init(&rks,&r_ctx,count,ws);
+        bad += (uint64_t)rks.k*rks.seg_len + rks.i != count || rks.i == 0 || rks.i > rks.seg_len;
+        XXTEA_FREE(ws);
+        printf("xxtea-rks-seg-len: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    {
+        // cached and uncached must agree: 3 sizes in a 2 entry cache
+
+        ayb_ks_cache_t cache;
+        uint32_t a[64], b[64];
+        unsigned j, k, bad = 0;
+
+        ayb_ks_cache_init(&cache,2,1 << 16);
+        for (j = 0; j < 12; ++j) {
+            int n = 4 + 16*(j % 3);
+            for (k = 0; k < (unsigned)n; ++k) {
+                a[k] = b[k] = j*k;
+            }
+            ayb_xxtea_cached(&cache,a,n,key);
+            ayb_xxtea(b,n,key);
+            bad += memcmp(a,b,n*sizeof(a[0])) != 0;
+            ayb_xxtea_cached(&cache,a,-n,key);
+            for (k = 0; k < (unsigned)n; ++k) {
+                bad += a[k] != j*k;
+            }
+        }
+        printf("xxtea-ks-cache: %s: hits=%lu, misses=%lu, evictions=%lu\n\n", bad == 0 ? "ok" : "FAILED",
+            (unsigned long)cache.hits, (unsigned long)cache.misses, (unsigned long)cache.evictions);
+        ayb_ks_cache_free(&cache);
+    }
+
+    {
+        // threads that miss on the same key at once must share one entry;
+        // a keystream larger than the cache is uncacheable, not a miss
+
+        ayb_ks_cache_test_t jobs[8];
+        ayb_ks_cache_t cache;
+        unsigned t, bad;
+
+        ayb_ks_cache_init(&cache,4,1 << 20);
+        for (t = 0; t < 8; ++t) {
+            jobs[t].cache = &cache;
+            jobs[t].key = key;
+        }
+        xxtea_run_jobs(ayb_ks_cache_test_worker,jobs,sizeof(jobs[0]),8);
+        bad = cache.nentries != 1 || cache.hits + cache.misses != 8 || cache.head->refs != 0;
+        bad += ayb_ks_cache_get(&cache,key,1 << 17) != 0 || cache.uncacheable != 1 || cache.hits + cache.misses != 8;
+        printf("xxtea-ks-cache-race: %s: hits=%lu, misses=%lu, uncacheable=%lu\n\n", bad == 0 ? "ok" : "FAILED",
+            (unsigned long)cache.hits, (unsigned long)cache.misses, (unsigned long)cache.uncacheable);
+        ayb_ks_cache_free(&cache);
+    }
+
+    {
+        // the prepared context must agree with xxtea() and ayb_xxtea()
+
+        static uint32_t a[4099], b[4099];
+        xxtea_ctx_t ctx[2];
+        unsigned k, bad = 0;
+        int n;
+
+        xxtea_ctx_init(&ctx[0],key,0);
+        xxtea_ctx_init(&ctx[1],key,1);
+        for (n = 2; n < 4099; n += n < 20 ? 1 : 1021) {
+            for (k = 0; k < (unsigned)n; ++k) {
+                a[k] = b[k] = n*k;
+            }
+            xxtea_ctx_encrypt(&ctx[0],a,n);
+            xxtea(b,n,key);
+            bad += memcmp(a,b,n*sizeof(a[0])) != 0;
+            xxtea_ctx_encrypt(&ctx[1],a,n);
+            ayb_xxtea(b,n,key);
+            bad += memcmp(a,b,n*sizeof(a[0])) != 0;
+            xxtea_ctx_decrypt(&ctx[1],a,n);
+            xxtea_ctx_decrypt(&ctx[0],a,n);
+            for (k = 0; k < (unsigned)n; ++k) {
+                bad += a[k] != n*k;
+            }
+        }
+        printf("xxtea-ctx: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    {
+        // split a block into random segments, including straddled words and
+        // empty segments, and compare with the contiguous result
+
+        static unsigned char a[4*1000], b[4*1000];
+        struct iovec iov[64];
+        xxtea_ctx_t ctx;
+        rnd32_t r = { 0, 0, 0x3243f6a8885a308dULL };
+        unsigned j, k, iovcnt, bad = 0;
+        size_t off;
+
+        for (j = 0; j < 200; ++j) {
+            unsigned n = 2 + rnd32(&r) % 999;
+            xxtea_ctx_init(&ctx,key,j & 1);
+            for (k = 0; k < 4*n; ++k) {
+                a[k] = b[k] = (unsigned char)(j + k);
+            }
+            for (off = 0, iovcnt = 0; iovcnt < 63 && off < 4*n; ++iovcnt) {
+                size_t len = rnd32(&r) % 23;
+                if (len > 4*n - off) len = 4*n - off;
+                iov[iovcnt].iov_base = &a[off];
+                iov[iovcnt].iov_len = len;
+                off += len;
+            }
+            iov[iovcnt].iov_base = &a[off];
+            iov[iovcnt++].iov_len = 4*n - off;
+
+            xxtea_ctx_iov_encrypt(&ctx,iov,iovcnt);
+            xxtea_ctx_encrypt(&ctx,(uint32_t *)b,n);
+            bad += memcmp(a,b,4*n) != 0;
+            xxtea_ctx_iov_decrypt(&ctx,iov,iovcnt);
+            for (k = 0; k < 4*n; ++k) {
+                bad += a[k] != (unsigned char)(j + k);
+            }
+        }
+        printf("xxtea-iov: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    {
+        // round trip, and a 1 bit change must change every sub-block
+
+        #define NWIDE (5*XXTEA_WIDE_BLOCK + 77)
+        static uint32_t a[NWIDE], b[NWIDE];
+        xxtea_ctx_t ctx;
+        unsigned j, k, bad = 0;
+        int ayb;
+
+        for (ayb = 0; ayb <= 1; ++ayb) {
+            xxtea_ctx_init(&ctx,key,ayb);
+            for (k = 0; k < NWIDE; ++k) {
+                a[k] = b[k] = k;
+            }
+            b[NWIDE-1] ^= 1;
+            xxtea_wide_encrypt(&ctx,a,NWIDE,4);
+            xxtea_wide_encrypt(&ctx,b,NWIDE,4);
+            for (j = 0; j < NWIDE/XXTEA_WIDE_BLOCK; ++j) {
+                bad += a[j*XXTEA_WIDE_BLOCK + 10] == b[j*XXTEA_WIDE_BLOCK + 10];
+            }
+            xxtea_wide_decrypt(&ctx,a,NWIDE,4);
+            for (k = 0; k < NWIDE; ++k) {
+                bad += a[k] != k;
+            }
+        }
+        printf("xxtea-wide: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    {
+        // the fused crc must equal crc32c() of the plaintext, and the cipher
+        // text must equal xxtea_ctx_encrypt()
+
+        #define NCRC (3*XXTEA_CRC_CHUNK + 5)
+        static uint32_t a[NCRC], b[NCRC];
+        xxtea_ctx_t ctx;
+        unsigned j, k, bad = 0;
+        int ayb, n;
+
+        bad += crc32c("123456789",9) != UINT32_C(0xe3069283);
+        for (ayb = 0; ayb <= 1; ++ayb) {
+            xxtea_ctx_init(&ctx,key,ayb);
+            for (j = 0; j < 40; ++j) {
+                n = j < 20 ? 2 + j : NCRC - (j - 20)*37;
+                for (k = 0; k < (unsigned)n; ++k) {
+                    a[k] = b[k] = k*DELTA + j;
+                }
+                uint32_t crc = crc32c(a,4*n);
+                bad += xxtea_ctx_encrypt_crc(&ctx,a,n) != crc;
+                xxtea_ctx_encrypt(&ctx,b,n);
+                bad += memcmp(a,b,4*n) != 0;
+                bad += xxtea_ctx_decrypt_crc(&ctx,a,n) != crc;
+                for (k = 0; k < (unsigned)n; ++k) {
+                    bad += a[k] != k*DELTA + j;
+                }
+            }
+        }
+        printf("xxtea-crc: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    {
+        // caller-supplied workspace: same result as ayb_xxtea(), and a too
+        // small workspace must be refused
+
+        #define NWS 1000
+        static uint32_t a[NWS], b[NWS];
+        static uint64_t ws[4096];
+        unsigned k, bad = 0;
+        int n;
+
+        for (n = 2; n <= NWS; n += n < 20 ? 1 : 97) {
+            for (k = 0; k < (unsigned)n; ++k) {
+                a[k] = b[k] = k;
+            }
+            bad += ayb_xxtea_ws_size(n) > sizeof(ws);
+            bad += ayb_xxtea_ws(a,n,key,0,0) != 0;
+            ayb_xxtea(b,n,key);
+            bad += memcmp(a,b,4*n) != 0;
+            if (n > 16) {
+                bad += ayb_xxtea_ws(a,-n,key,ws,ayb_xxtea_ws_size(n)-1) != -1;
+                bad += memcmp(a,b,4*n) != 0;
+            }
+            bad += ayb_xxtea_ws(a,-n,key,ws,sizeof(ws)) != 0;
+            for (k = 0; k < (unsigned)n; ++k) {
+                bad += a[k] != k;
+            }
+        }
+        printf("xxtea-ws: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    {
+        // streaming in random pieces must equal the bulk path, and round trip
+
+        #define NMODE 5000
+        static unsigned char a[NMODE + 64], b[NMODE + 64], c[NMODE + 64];
+        const uint32_t iv[XXTEA_MODE_MAX_N] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+        rnd32_t r = { 0, 0, 0xb5ad4eceda1ce2a9ULL };
+        xxtea_ctx_t ctx;
+        xxtea_mode_t m;
+        unsigned k, bad = 0, n;
+        size_t off, w, len, piece;
+        int ayb, rc;
+
+        for (k = 0; k < NMODE; ++k) {
+            a[k] = (unsigned char)(k*7 + 1);
+        }
+        for (ayb = 0; ayb <= 1; ++ayb) {
+            xxtea_ctx_init(&ctx,key,ayb);
+            for (n = 2; n <= XXTEA_MODE_MAX_N; n += 3) {
+                len = NMODE - n*13;
+
+                // CTR
+                xxtea_ctr(&ctx,n,iv,7,a,b,len,4);
+                xxtea_mode_init(&m,&ctx,XXTEA_CTR,n,iv,4);
+                m.ctr = 7;
+                for (off = w = 0; off < len; off += piece) {
+                    piece = rnd32(&r) % 200;
+                    if (piece > len - off) piece = len - off;
+                    w += xxtea_mode_update(&m,a + off,c + w,piece);
+                }
+                bad += w != len || memcmp(b,c,len) != 0;
+                xxtea_ctr(&ctx,n,iv,7,c,c,len,3);
+                bad += memcmp(a,c,len) != 0;
+
+                // CBC
+                xxtea_mode_init(&m,&ctx,XXTEA_CBC_ENCRYPT,n,iv,4);
+                for (off = w = 0; off < len; off += piece) {
+                    piece = rnd32(&r) % 200;
+                    if (piece > len - off) piece = len - off;
+                    w += xxtea_mode_update(&m,a + off,b + w,piece);
+                }
+                w += xxtea_mode_final(&m,b + w);
+                bad += w != (len / (4*n) + 1) * 4*n;
+                xxtea_cbc_decrypt(&ctx,n,iv,b,c,w / (4*n),4);
+                bad += memcmp(a,c,len) != 0 || c[w-1] != w - len;
+
+                xxtea_mode_init(&m,&ctx,XXTEA_CBC_DECRYPT,n,iv,4);
+                len = w;
+                for (off = w = 0; off < len; off += piece) {
+                    piece = rnd32(&r) % 200;
+                    if (piece > len - off) piece = len - off;
+                    w += xxtea_mode_update(&m,b + off,c + w,piece);
+                }
+                rc = xxtea_mode_final(&m,c + w);
+                bad += rc < 0 || w + rc != NMODE - n*13 || memcmp(a,c,w + rc) != 0;
+
+                xxtea_mode_init(&m,&ctx,XXTEA_CBC_DECRYPT,n,iv,4);
+                w = xxtea_mode_update(&m,b,c,len - 1);
+                bad += xxtea_mode_final(&m,c + w) != -1;
+            }
+        }
+        printf("xxtea-mode: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    {
+        // unaligned records of random length: same as one xxtea() per record
+
+        #define NREC 300
+        static unsigned char a[1 + NREC*(4*XXTEA_REC_MAX_N + 8)];
+        static uint32_t b[NREC*(XXTEA_REC_MAX_N + 2)];
+        static size_t off[NREC+1];
+        rnd32_t r = { 0, 0, 0x9e3779b97f4a7c15ULL };
+        unsigned i, k, bad = 0;
+        int ayb;
+
+        off[0] = 1;
+        for (i = 0; i < NREC; ++i) {
+            unsigned n = i == 17 ? XXTEA_REC_MAX_N + 2 : 2 + rnd32(&r) % (XXTEA_REC_MAX_N - 1);
+            off[i+1] = off[i] + 4*n;
+        }
+        for (ayb = 0; ayb <= 1; ++ayb) {
+            for (k = 0; k < off[NREC]; ++k) {
+                a[k] = (unsigned char)(k*13);
+            }
+            memcpy(b,a + 1,off[NREC] - 1);
+            xxtea_records(a,off,NREC,key,ayb,0);
+            for (i = 0; i < NREC; ++i) {
+                (ayb ? ayb_xxtea : xxtea)(b + (off[i] - 1)/4,(int)(off[i+1] - off[i])/4,key);
+            }
+            bad += memcmp(a + 1,b,off[NREC] - 1) != 0;
+            xxtea_records(a,off,NREC,key,ayb,1);
+            for (k = 0; k < off[NREC]; ++k) {
+                bad += a[k] != (unsigned char)(k*13);
+            }
+        }
+        printf("xxtea-records: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    {
+        // the bulk fills must equal single rnd32() calls, for any count
+
+        static uint32_t a[1000], b[1000];
+        rnd32_t r = { 0, 0, 0xb5ad4eceda1ce2a9ULL }, q = r, st[RND32_STREAMS], st2[RND32_STREAMS];
+        uint64_t c[500];
+        unsigned i, k, n, bad = 0;
+
+        for (n = 0; n < 1000; n += 1 + n/3) {
+            for (i = 0; i < n; ++i) {
+                a[i] = rnd32(&r);
+            }
+            rnd32_fill(&q,b,n);
+            bad += memcmp(a,b,n*sizeof(a[0])) != 0 || r.x != q.x || r.w != q.w;
+        }
+        for (i = 0; i < 1000; ++i) {
+            a[i] = rnd32(&r);
+        }
+        rnd64_fill(&q,c,500);
+        for (i = 0; i < 500; ++i) {
+            bad += c[i] != (a[2*i] | (uint64_t)a[2*i+1] << 32);
+        }
+        for (k = 0; k < RND32_STREAMS; ++k) {
+            st[k].x = st[k].w = 0;
+            st[k].S = 0x9e3779b97f4a7c15ULL + 2*k;
+        }
+        memcpy(st2,st,sizeof(st));
+        for (i = 0; i < 999; ++i) {
+            a[i] = rnd32(&st2[i % RND32_STREAMS]);
+        }
+        rnd32_fill_streams(st,b,999);
+        bad += memcmp(a,b,999*sizeof(a[0])) != 0 || memcmp(st,st2,sizeof(st)) != 0;
+        printf("rnd32-fill: %s\n\n", bad == 0 ? "ok" : "FAILED");
+    }
+
+    return 0;
+}
+
+#endif // XXTEA_NO_MAIN